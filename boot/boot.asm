@@ -1,5 +1,9 @@
 [org 0x7c00]
 KERNEL_OFFSET equ 0x9000 ; on change also update linker.ld and recompile all *.c files
+E820_MAP equ 0x1000 ; dword entry count + entries, on change also update e820.h
+E820_ENTRY_SIZE equ 24
+E820_MAX_ENTRIES equ 32
+E820_SMAP equ 0x534D4150 ; 'SMAP'
 
 %ifndef KERNEL_SECTORS
 %define KERNEL_SECTORS 12
@@ -31,6 +35,8 @@ start:
   mov si, msg_kernel_loaded
   call print_str
 
+  call detect_memory
+
   call switch_to_pm
   jmp $
 
@@ -62,6 +68,34 @@ load_kernel:
   call disk_load
   ret
 
+; ===== E820 MEMORY MAP =====
+; stores BIOS memory map at E820_MAP, count stays 0 if E820 is not supported
+detect_memory:
+  pushad
+  mov dword [E820_MAP], 0
+  mov di, E820_MAP + 4
+  xor ebx, ebx
+.next_entry:
+  mov eax, 0xE820
+  mov ecx, E820_ENTRY_SIZE
+  mov edx, E820_SMAP
+  mov dword [di + 20], 1 ; ACPI 3.0 attributes, valid unless BIOS says otherwise
+  int 0x15
+  jc .done               ; carry on first call = unsupported, later = end of list
+  cmp eax, E820_SMAP
+  jne .done
+  jcxz .skip_entry
+  inc dword [E820_MAP]
+  add di, E820_ENTRY_SIZE
+  cmp dword [E820_MAP], E820_MAX_ENTRIES
+  je .done
+.skip_entry:
+  test ebx, ebx
+  jnz .next_entry
+.done:
+  popad
+  ret
+
 ; ===== PRINT TO SCREEN =====
 print_str:
   pusha
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <lib/types.h>
+
+// disables interrupts and returns EFLAGS from before, for irq_restore
+static inline uint32_t irq_save(void)
+{
+    uint32_t eflags;
+    asm volatile("pushf\n\tpop %0\n\tcli" : "=r"(eflags)::"memory");
+    return eflags;
+}
+
+static inline void irq_restore(uint32_t eflags)
+{
+    if (eflags & (1 << 9)) // IF
+        asm volatile("sti" ::: "memory");
+}
+
+void cpu_idle(void);
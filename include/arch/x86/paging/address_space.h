@@ -0,0 +1,22 @@
+#pragma once
+
+#include <lib/types.h>
+
+/* Page directory of one context.
+Kernel half PDEs point to the same page tables as the kernel PD, so kernel
+mappings are shared by reference. Kernel half PDE changes made later are copied
+into every address space. User half (below KERNEL_VMA) belongs to the address space only.
+Kernel pages are global, so switching drops only user TLB entries */
+typedef struct
+{
+    uint32_t pd_phys;
+} address_space_t;
+
+// creates PD with shared kernel half and empty user half. Returns false if out of frames or address space slots
+bool_t address_space_init(address_space_t *as);
+
+// loads PD of given address space, NULL switches back to the kernel PD
+void address_space_switch(address_space_t *as);
+
+// unmaps and frees user half pages, its page tables and the PD itself
+void address_space_destroy(address_space_t *as);
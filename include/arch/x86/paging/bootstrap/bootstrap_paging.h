@@ -5,4 +5,6 @@
 
 void bootstrap_setup_mapping(void);
 void bootstrap_enable_global_pages(void);
+void bootstrap_enable_large_pages(void);
+void bootstrap_setup_pat(void);
 void bootstrap_enable_paging(void);
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <lib/types.h>
+#include <lib/hbitmap.h>
+
+#define BUDDY_MAX_ORDER 10 // largest block is 1024 frames = 4 MiB
+#define BUDDY_ORDERS (BUDDY_MAX_ORDER + 1)
+
+/* storage words for free block bitmaps of all orders over given frame count.
+Every order has at most half the bits of the one below, plus rounding per level */
+#define BUDDY_STORAGE_WORDS(frames) (2 * HBITMAP_WORDS(frames) + HBITMAP_MAX_LEVELS * BUDDY_ORDERS)
+
+/* Binary buddy allocator of physical frames.
+Frames are not mapped, so free blocks can not be linked through themselves.
+Instead every order has a hierarchical bitmap with one bit per block of that order,
+set while the block is free and not merged into a bigger one */
+
+void buddy_init(uint32_t frames, uint32_t *storage);
+
+// returns first frame of a free block of 2^order frames or -1
+int32_t buddy_alloc(uint32_t order);
+
+// gives block of 2^order frames back, merging it with its free buddies
+void buddy_free(uint32_t frame, uint32_t order);
+
+// frees any frame range, split into the largest aligned blocks
+void buddy_free_range(uint32_t frame, uint32_t count);
+
+// takes frames that are free out of the allocator
+void buddy_reserve_range(uint32_t frame, uint32_t count);
+
+uint32_t buddy_free_frames(void);
+
+// smallest order that holds given frame count
+uint32_t buddy_order_for(uint32_t frames);
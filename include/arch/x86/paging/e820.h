@@ -0,0 +1,30 @@
+#pragma once
+
+#include <lib/types.h>
+
+#define E820_MAP_PHYS 0x1000 // filled by boot.asm, on change also update E820_MAP there
+#define E820_MAX_ENTRIES 32
+
+#define E820_TYPE_USABLE 1
+#define E820_TYPE_RESERVED 2
+#define E820_TYPE_ACPI_RECLAIMABLE 3
+#define E820_TYPE_ACPI_NVS 4
+#define E820_TYPE_BAD 5
+
+#define E820_ACPI_VALID 0x1 // entry should be ignored when clear
+
+/* one entry of INT 15h, AX=E820h memory map */
+typedef struct
+{
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+    uint32_t acpi; // ACPI 3.0 extended attributes
+} __attribute__((packed)) e820_entry_t;
+
+/* layout left by the boot sector at E820_MAP_PHYS */
+typedef struct
+{
+    uint32_t count;
+    e820_entry_t entries[E820_MAX_ENTRIES];
+} __attribute__((packed)) e820_map_t;
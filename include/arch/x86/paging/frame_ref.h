@@ -0,0 +1,16 @@
+#pragma once
+
+#include <lib/types.h>
+
+#define FRAME_REF_TABLE_SIZE 1024 // must be power of two, max number of frames shared at once
+
+/* Reference counts of frames mapped copy-on-write at more than one place.
+Frames not in the table have one owner, so the table only holds shared ones */
+
+// adds one more mapping of given PHYSICAL frame. Returns false if the table is full
+bool_t frame_ref_share(uint32_t phys);
+
+// drops one mapping, returns true if the caller was the last one and the frame can be freed
+bool_t frame_ref_put(uint32_t phys);
+
+uint32_t frame_ref_count(uint32_t phys);
@@ -14,10 +14,11 @@ typedef struct
             uint32_t pwt : 1;      // Write-through
             uint32_t pcd : 1;      // Cache disable
             uint32_t accessed : 1; // CPU sets on access
-            uint32_t ps : 1;       // Page size: 0 = 4 KiB, 1 = 4 MiB
-            uint32_t reserved : 1; // reserved
-            uint32_t avl : 4;      // available for OS
-            uint32_t addr : 20;    // [31:12] physical address (aligned)
+            uint32_t dirty : 1;    // CPU sets on write, 4 MiB pages only
+            uint32_t ps : 1;       // Page size: 0 = 4 KiB, 1 = 4 MiB (needs CR4.PSE)
+            uint32_t global : 1;   // global page, 4 MiB pages only
+            uint32_t avl : 3;      // available for OS
+            uint32_t addr : 20;    // [31:12] physical address (aligned), 4 MiB pages: [31:22] with PAT in bit 12
         } fields;
         uint32_t raw_data;
     };
@@ -50,13 +51,13 @@ inline void pde_set_pwt_flag(pde_t *entry, bool_t val) { entry->fields.pwt = val
 false = caching | true = no caching */
 inline void pde_set_pcd_flag(pde_t *entry, bool_t val) { entry->fields.pcd = val != 0; }
 
-/* User/Supervisor
-false = ring 0 only | true = allow ring 3 */
+/* Page Size
+false = entry points to page table | true = entry maps 4 MiB page */
 inline void pde_set_ps_flag(pde_t *entry, bool_t val) { entry->fields.ps = val != 0; }
 
 /* Available for OS - any info. CPU will ignore that
-Any 4(!) bits*/
-inline void pde_set_avl_flag(pde_t *entry, uint8_t val) { entry->fields.avl = (val & 0xF); }
+Any 3(!) bits*/
+inline void pde_set_avl_flag(pde_t *entry, uint8_t val) { entry->fields.avl = (val & 0x7); }
 
 inline uint8_t pde_get_avl_flag(pde_t *entry) { return entry->fields.avl; }
 inline bool_t pde_get_accesed_flag(pde_t *entry) { return entry->fields.accessed; }
@@ -73,5 +74,6 @@ inline void pde_init(pde_t *entry, uint32_t addr, bool_t rw, bool_t us, bool_t p
     pde_set_avl_flag(entry, avl);
     pde_set_present_flag(entry, 1);
     entry->fields.accessed = 0;
-    entry->fields.reserved = 0;
+    entry->fields.dirty = 0;
+    entry->fields.global = 0;
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <lib/types.h>
 #include <paging/page_directory.h>
+#include <paging/e820.h>
 
 extern uint8_t __phys_after_bootstrap_data; // from linker script
 extern uint8_t __phys_after_kernel;         // from linker script
@@ -12,8 +13,17 @@ extern uint8_t __phys_after_kernel;         // from linker script
 #define KERNEL_PHYS_END (uint32_t)&__phys_after_kernel
 #define PAGE_PRESENT 0x1
 #define PAGE_RW 0x2
+#define PAGE_USER 0x4
+#define PAGE_PWT 0x8
+#define PAGE_PCD 0x10
+#define PAGE_WC PAGE_PWT            // PAT entry 1 is programmed to write-combining at boot
+#define PAGE_UC (PAGE_PWT | PAGE_PCD) // PAT entry 3, strong uncacheable
 #define PAGE_SIZE 0x1000
-#define TOTAL_FRAMES 1024 * 1024
+#define LARGE_PAGE_SIZE 0x400000 // 4 MiB PSE page, one PD entry
+#define PAGES_PER_TABLE 1024
+#define CR4_PSE (1 << 4)
+#define CR4_PGE (1 << 7)
+#define TOTAL_FRAMES 1024 * 1024 // frames of the whole 4 GiB, the allocator covers only get_frame_count() of them
 
 #define HIGH_HALF_STACK_CAPACITY 0x3FFFC
 
@@ -24,6 +34,20 @@ extern uint8_t __phys_after_kernel;         // from linker script
 #define BOOTSTRAP_STACK_TOP 0x9FFFC
 
 #define TEMP_PD_VADDR 0xF0000000
+#define TEMP_COPY_VADDR 0xF0001000 // window for zeroing and copying frames that are not mapped
+#define KERNEL_PD_VADDR 0xF0002000 // permanent mapping of the kernel PD
+
+#define KERNEL_PDE_START (KERNEL_VMA >> 22) // first PDE of the kernel half, shared by all address spaces
+#define RECURSIVE_PDE 1023                 // PD maps itself here, page tables are at 0xFFC00000
+
+#define PAGE_AVL_COW 0x1        // PTE avl bit: read-only because frame is shared, first write copies it
+#define PAGE_AVL_SOFT_DIRTY 0x2 // PTE/PDE avl bit: dirty flag moved aside by scan_page_access
+
+/* scan_page_access result bits */
+#define PAGE_SCAN_PRESENT 0x1
+#define PAGE_SCAN_ACCESSED 0x2
+#define PAGE_SCAN_DIRTY 0x4    // written since the previous scan
+#define PAGE_SCAN_NO_TABLE 0x8 // PD entry not present, the rest of its 4 MiB can be skipped
 
 void setup_high_half_selfcontained_paging(void);
 
@@ -41,12 +65,61 @@ void map_page(uint32_t virt, uint32_t phys, uint32_t flags);
 
 void map_range(uint32_t virt_start, uint32_t phys_start, uint32_t pages, uint32_t flags);
 
+bool_t map_alloc_range(uint32_t virt_start, uint32_t pages, uint32_t flags);
+
 void unmap_page(uint32_t virt);
 
+void unmap_range(uint32_t virt_start, uint32_t pages, bool_t free_frames);
+
+void flush_tlb_global(void);
+
+bool_t is_page_mapped(uint32_t virt);
+
+bool_t pat_supported(void);
+
+bool_t map_zero_range(uint32_t virt_start, uint32_t pages);
+
+bool_t clone_range(uint32_t dst_start, uint32_t src_start, uint32_t pages);
+
+bool_t is_page_cow(uint32_t virt);
+
+bool_t break_cow(uint32_t virt, bool_t *copied);
+
+bool_t get_page_dirty_flag(uint32_t virt);
+
+uint32_t scan_page_access(uint32_t virt);
+
 uint32_t alloc_frame(void);
 
+uint32_t alloc_zeroed_frame(void);
+
+bool_t refill_zero_pool(void);
+
+// one buddy block, so at most 1 << BUDDY_MAX_ORDER pages (4 MiB). Returns 0 for bigger requests
 uint32_t alloc_contiguous_frames(uint32_t pages);
 
 void free_frame(uint32_t phys_addr);
 
-volatile pde_t *create_page_directory(void);
+void free_contiguous_frames(uint32_t phys_addr, uint32_t pages);
+
+extern pde_t *kernel_page_directory;
+
+void load_page_directory(pde_t page_dir[1024]);
+
+void load_page_directory_phys(uint32_t pd_phys);
+
+uint32_t get_current_page_directory_phys(void);
+
+uint32_t get_kernel_page_directory_phys(void);
+
+bool_t sync_kernel_pde(uint32_t virt);
+
+bool_t track_page_directory(uint32_t pd_phys);
+
+void untrack_page_directory(uint32_t pd_phys);
+
+uint32_t get_frame_count(void);
+
+uint32_t get_free_frame_count(void);
+
+const e820_entry_t *get_memory_map(uint32_t *count);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <lib/types.h>
+
+#define VM_REGION_MAX 16
+
+#define VM_REGION_WRITABLE 0x1
+#define VM_REGION_DEMAND_ZERO 0x2 // not present pages are backed by zeroed frames on first touch
+
+/* page fault error code bits */
+#define PF_PRESENT 0x1 // 0 = page not present, 1 = protection violation
+#define PF_WRITE 0x2
+#define PF_USER 0x4
+
+typedef struct vm_region vm_region_t;
+
+/* called after the handler mapped a new page of the region */
+typedef void (*vm_fault_hook_t)(vm_region_t *region, uint32_t page);
+
+/* Registered virtual range the page fault handler is allowed to back.
+Minor faults are resolved without a new frame (mapping already there, stale TLB,
+kernel PDE synced into an address space, last owner of a copy-on-write frame), major faults needed a frame to be allocated
+and zeroed or copied */
+typedef struct vm_region
+{
+    const char *name;
+    uint32_t start; // page aligned
+    uint32_t end;   // exclusive, page aligned
+    uint32_t flags;
+    uint32_t minor_faults;
+    uint32_t major_faults;
+    vm_fault_hook_t on_fault;
+} vm_region_t;
+
+// returns registered region or NULL if table is full or range overlaps other region
+vm_region_t *vm_region_register(const char *name, uint32_t start, uint32_t end, uint32_t flags, vm_fault_hook_t on_fault);
+
+void vm_region_unregister(vm_region_t *region);
+
+vm_region_t *vm_region_find(uint32_t addr);
+
+uint32_t vm_region_count(void);
+
+vm_region_t *vm_region_get(uint32_t index);
+
+void vm_region_print_stats(void);
+
+// resolves page fault at given addr. Returns false if the fault must escalate
+bool_t handle_page_fault(uint32_t fault_addr, uint32_t err_code);
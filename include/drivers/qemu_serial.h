@@ -10,6 +10,8 @@ void serial_write_char(char c);
 
 void serial_write_str(const char *s);
 
+void serial_write_bytes(const void *data, uint32_t length);
+
 void serial_write_hex_uint8(unsigned char byte);
 
 void serial_write_hex_uint32(uint32_t value);
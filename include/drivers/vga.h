@@ -8,6 +8,11 @@ void set_graphics_mode(void);
 void set_text_mode(void);
 void draw_mode13h_test_pattern(void);
 
+#ifdef VGA_BENCH
+void vga_cache_benchmark_13h(void);
+void vga_cache_benchmark_text(void);
+#endif
+
 const uint8_t *get_8x16_font_glyph(uint8_t glyph_code);
 
 void write_font(const uint8_t font[256][FONT_HEIGHT]);
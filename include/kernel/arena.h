@@ -0,0 +1,31 @@
+#pragma once
+
+#include <lib/types.h>
+
+#define ARENA_CHUNK_SIZE 0x10000 // default chunk size, bigger requests get own chunk
+
+typedef struct arena_chunk arena_chunk_t;
+
+/* header placed at the start of every page-backed chunk */
+typedef struct arena_chunk
+{
+    arena_chunk_t *next;
+    uint32_t size; // usable bytes after the header
+    uint32_t used;
+} arena_chunk_t;
+
+/* region allocator: allocation is a pointer bump,
+memory is only given back all at once by arena_reset/arena_destroy */
+typedef struct
+{
+    arena_chunk_t *head;
+    arena_chunk_t *current; // chunk allocations are bumped from
+} arena_t;
+
+void arena_init(arena_t *arena);
+
+void *arena_alloc(arena_t *arena, uint32_t n);
+
+void arena_reset(arena_t *arena);
+
+void arena_destroy(arena_t *arena);
@@ -5,16 +5,99 @@
 #define HEAP_START 0xD0000000
 #define HEAP_END 0xE0000000
 
+/* small allocations are served by size-class slabs
+from the beginning of the heap window */
+#define SLAB_START HEAP_START
+#define SLAB_END (HEAP_START + 0x02000000)
+#define SLAB_SIZE 0x4000 // must be power of two, slabs are aligned to it
+#define SLAB_MIN_OBJ_SIZE 8
+#define SLAB_MAX_OBJ_SIZE 2048
+#define SLAB_CLASS_COUNT 9 // 8, 16, 32 ... 2048
+
+#define BLOCK_USED 0x1
+#define BLOCK_TAG_SIZE sizeof(uint32_t)
+#define BLOCK_OVERHEAD (2 * BLOCK_TAG_SIZE) // header + footer
+
 typedef struct block block_t;
 
+/* heap block with boundary tags.
+`size` is the whole block size (tags included, multiple of 8) with BLOCK_USED in the low bit.
+The last word of every block repeats `size` as a footer, so both neighbours are found in O(1).
+next/prev overlap the payload and are valid only while the block is free */
 typedef struct block
 {
     uint32_t size;
-    block_t *next;
+    block_t *next; // next free block in the same size bin
+    block_t *prev;
 } block_t;
 
+typedef struct slab slab_t;
+
+/* header placed at the start of every slab */
+typedef struct slab
+{
+    slab_t *next; // next slab of the same class with free objects
+    slab_t *prev;
+    void *free_list;  // freed objects, linked through their first word
+    uint8_t *unused;  // first never handed out object
+    uint16_t obj_size;
+    uint16_t capacity;
+    uint16_t in_use;
+    uint8_t class_index;
+} slab_t;
+
+/* heap counters, maintained on malloc/free paths */
+typedef struct
+{
+    uint32_t bytes_in_use;
+    uint32_t peak_bytes_in_use;
+    uint32_t alloc_count;
+    uint32_t free_count;
+    uint32_t free_bytes; // free space of the large block heap
+    uint32_t free_blocks;
+    uint32_t largest_free_block;
+    uint32_t fragmentation; // external fragmentation in percent: 100 * (1 - largest_free_block / free_bytes)
+} heap_stats_t;
+
 void heap_init(void);
 
 void *malloc(uint32_t n);
 
 void free(void *addr);
+
+void *realloc(void *addr, uint32_t n);
+
+void *calloc(uint32_t count, uint32_t size);
+
+void *kmalloc_aligned(uint32_t n, uint32_t align);
+
+void kfree_aligned(void *addr);
+
+void dump_heap(void);
+
+void heap_get_stats(heap_stats_t *stats);
+
+void heap_print_stats(void);
+
+#ifdef HEAP_TRACE
+
+#define HEAP_TRACE_RING_SIZE 1024 // must be power of two, oldest records are overwritten
+
+#define HEAP_TRACE_MALLOC 1
+#define HEAP_TRACE_FREE 2
+#define HEAP_TRACE_REALLOC 3
+#define HEAP_TRACE_CALLOC 4
+#define HEAP_TRACE_MALLOC_ALIGNED 5
+
+typedef struct
+{
+    uint32_t timestamp; // PIT ticks
+    uint32_t caller;    // return address of the heap API call
+    uint32_t size;
+    uint32_t ptr;
+    uint8_t op;
+} __attribute__((packed)) heap_trace_record_t;
+
+void heap_trace_drain(void);
+
+#endif
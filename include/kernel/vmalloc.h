@@ -0,0 +1,25 @@
+#pragma once
+
+#include <lib/types.h>
+
+#define VMALLOC_START 0xE0000000
+#define VMALLOC_END 0xF0000000 // TEMP_PD_VADDR and other fixed windows start here
+
+#define VMALLOC_MAX_RANGES 64 // free virtual ranges tracked at once
+#define VMALLOC_MAX_AREAS 128 // live allocations
+
+/* Page granular allocations that are only virtually contiguous.
+Every page gets its own frame, so big buffers never need contiguous RAM and
+stay out of the small object heap. Each area is followed by an unmapped guard page */
+
+void vmalloc_init(void);
+
+// maps fresh frames, content is not zeroed
+void *vmalloc(uint32_t size);
+
+// maps the shared zero frame copy-on-write, frames are taken only for pages that get written
+void *vzalloc(uint32_t size);
+
+void vfree(void *addr);
+
+void vmalloc_print_stats(void);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <lib/types.h>
+
+#define WS_TICKS_PER_STEP 10  // PIT ticks between scan steps
+#define WS_SCAN_BUDGET 128    // PTEs sampled per step, a not present PD entry counts once
+#define WS_WINDOW_PASSES 4    // pages accessed within that many passes form the working set
+#define WS_COLD_PASSES 16     // pages not accessed for that many passes are cold
+#define WS_LIST_MAX 16        // page addresses kept in each hot and cold list
+
+/* Working set estimation of registered vm regions.
+A PIT task walks the regions with an incremental cursor, sampling and clearing the accessed
+and dirty flags of every page. Each page keeps its age, the number of passes since it was
+last accessed. Stats below describe the last completed pass over the region */
+typedef struct
+{
+    const char *name;
+    uint32_t start;
+    uint32_t end;
+    uint32_t passes;            // completed passes
+    uint32_t pass_ticks;        // PIT ticks the last pass took
+    uint32_t resident_pages;    // mapped pages
+    uint32_t working_set_pages; // accessed within the last WS_WINDOW_PASSES passes
+    uint32_t hot_pages;         // accessed during the last pass
+    uint32_t cold_pages;        // not accessed for WS_COLD_PASSES passes or more
+    uint32_t dirty_pages;       // written during the last pass
+    uint32_t hot_count;
+    uint32_t hot[WS_LIST_MAX]; // first hot pages by address
+    uint32_t cold_count;
+    uint32_t cold[WS_LIST_MAX]; // coldest pages, oldest first
+} working_set_stats_t;
+
+// starts tracking every region registered so far and installs the scanner PIT task
+void working_set_init(void);
+
+uint32_t working_set_region_count(void);
+
+// copies stats of tracked region at given index, returns false if there is none
+bool_t working_set_get_stats(uint32_t index, working_set_stats_t *out);
+
+void working_set_print_stats(void);
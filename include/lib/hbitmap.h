@@ -0,0 +1,27 @@
+#pragma once
+
+#include <lib/types.h>
+
+#define HBITMAP_MAX_LEVELS 4 // up to 32^4 = 1M bits
+
+/* words of storage needed for hbitmap of given bit count */
+#define HBITMAP_WORDS(bits) (((bits) + 31) / 32 + ((bits) + 1023) / 1024 + \
+                             ((bits) + 32767) / 32768 + ((bits) + 1048575) / 1048576)
+
+/* Hierarchical bitmap.
+levels[0] holds the bits, bit j of levels[i + 1] is set while word j of levels[i] is not zero.
+Top level fits in one word, so the first set bit is found with one ctz per level */
+typedef struct
+{
+    uint32_t *levels[HBITMAP_MAX_LEVELS];
+    uint32_t level_count;
+    uint32_t bits;
+} hbitmap_t;
+
+void hbitmap_init(hbitmap_t *bm, uint32_t *storage, uint32_t bits);
+
+void hbitmap_set(hbitmap_t *bm, uint32_t index);
+void hbitmap_clear(hbitmap_t *bm, uint32_t index);
+bool_t hbitmap_get(const hbitmap_t *bm, uint32_t index);
+
+int32_t hbitmap_find_first(const hbitmap_t *bm);
@@ -0,0 +1,163 @@
+#pragma once
+
+extern "C"
+{
+#include <lib/types.h>
+#include <kernel/memory.h>
+}
+
+#define CACHE_LINE_SIZE 64
+
+// placement new, there is no <new> in the freestanding build
+inline void *operator new(__SIZE_TYPE__, void *ptr) noexcept { return ptr; }
+
+/* storage of one pooled object. While free, the first word links it into the pool free list */
+template <typename T>
+union PoolSlot
+{
+    PoolSlot *next;
+    alignas(T) uint8_t storage[sizeof(T)];
+};
+
+/* Fixed capacity pool of N objects stored inline.
+acquire/release are O(1): freed slots go to an intrusive free list,
+never used slots are handed out by a bump index.
+The constructor is constexpr and leaves everything zero, so pools work as globals
+even though the kernel never runs global constructors */
+template <typename T, uint32_t N>
+class ObjectPool
+{
+public:
+    constexpr ObjectPool() : slots{} {}
+
+    // constructs T in a free slot, returns nullptr when the pool is exhausted
+    template <typename... Args>
+    T *acquire(Args &&...args)
+    {
+        PoolSlot<T> *slot = free_list;
+        if (slot)
+            free_list = slot->next;
+        else if (unused < N)
+            slot = &slots[unused++];
+        else
+            return nullptr;
+
+        in_use++;
+        return new (slot->storage) T(static_cast<Args &&>(args)...);
+    }
+
+    // destroys obj and returns its slot to the pool
+    void release(T *obj)
+    {
+        if (!obj)
+            return;
+
+        obj->~T();
+        PoolSlot<T> *slot = reinterpret_cast<PoolSlot<T> *>(obj);
+        slot->next = free_list;
+        free_list = slot;
+        in_use--;
+    }
+
+    bool_t owns(const T *obj) const
+    {
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(obj);
+        return p >= reinterpret_cast<const uint8_t *>(slots) && p < reinterpret_cast<const uint8_t *>(slots + N);
+    }
+
+    uint32_t size() const { return in_use; }
+
+    static constexpr uint32_t capacity() { return N; }
+
+private:
+    alignas(CACHE_LINE_SIZE) PoolSlot<T> slots[N];
+    PoolSlot<T> *free_list = nullptr;
+    uint32_t unused = 0;
+    uint32_t in_use = 0;
+};
+
+/* Growable pool. Storage comes from the kernel heap in cache line aligned slabs
+of SlabObjects slots each, slabs are only given back by destroy(), there is no destructor
+so globals need no __cxa_atexit. acquire/release are O(1), a new slab is taken only when
+every slot is in use */
+template <typename T, uint32_t SlabObjects = 64>
+class DynamicPool
+{
+public:
+    constexpr DynamicPool() = default;
+
+    // constructs T in a free slot, returns nullptr when the heap is exhausted
+    template <typename... Args>
+    T *acquire(Args &&...args)
+    {
+        PoolSlot<T> *slot = free_list;
+        if (slot)
+            free_list = slot->next;
+        else if (unused != unused_end || grow())
+            slot = unused++;
+        else
+            return nullptr;
+
+        in_use++;
+        return new (slot->storage) T(static_cast<Args &&>(args)...);
+    }
+
+    // destroys obj and returns its slot to the pool
+    void release(T *obj)
+    {
+        if (!obj)
+            return;
+
+        obj->~T();
+        PoolSlot<T> *slot = reinterpret_cast<PoolSlot<T> *>(obj);
+        slot->next = free_list;
+        free_list = slot;
+        in_use--;
+    }
+
+    // gives every slab back to the heap. Objects still in use are not destroyed
+    void destroy()
+    {
+        while (slabs)
+        {
+            Slab *next = slabs->next;
+            kfree_aligned(slabs);
+            slabs = next;
+        }
+        free_list = nullptr;
+        unused = unused_end = nullptr;
+        in_use = 0;
+    }
+
+    uint32_t size() const { return in_use; }
+
+private:
+    struct Slab
+    {
+        Slab *next;
+    };
+
+    // slots start one cache line after the slab header
+    static constexpr uint32_t SLAB_HEADER_SIZE =
+        ((sizeof(Slab) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE) * CACHE_LINE_SIZE;
+
+    bool_t grow()
+    {
+        Slab *slab = static_cast<Slab *>(
+            kmalloc_aligned(SLAB_HEADER_SIZE + SlabObjects * sizeof(PoolSlot<T>), CACHE_LINE_SIZE));
+        if (!slab)
+            return false;
+
+        slab->next = slabs;
+        slabs = slab;
+        unused = reinterpret_cast<PoolSlot<T> *>(reinterpret_cast<uint8_t *>(slab) + SLAB_HEADER_SIZE);
+        unused_end = unused + SlabObjects;
+        return true;
+    }
+
+    Slab *slabs = nullptr;
+    PoolSlot<T> *free_list = nullptr;
+    PoolSlot<T> *unused = nullptr; // never used slots of the newest slab
+    PoolSlot<T> *unused_end = nullptr;
+    uint32_t in_use = 0;
+};
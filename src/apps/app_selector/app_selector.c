@@ -3,6 +3,9 @@
 #include <drivers/keyboard.h>
 #include <lib/string.h>
 #include <timer/pit.h>
+#include <kernel/arena.h>
+#include <kernel/memory.h>
+#include <paging/address_space.h>
 
 #include "../snake/snake.h"
 #include "../text_sandbox/text_sandbox.h"
@@ -28,6 +31,15 @@ static App apps[] = {
 
 #define APP_COUNT (uint8_t)(sizeof(apps) / sizeof(App))
 
+static arena_t app_arena;
+static address_space_t app_address_space;
+
+// memory of currently running app, everything in it is dropped when the app exits
+arena_t *get_app_arena(void)
+{
+    return &app_arena;
+}
+
 void app_selector()
 {
     while (true)
@@ -49,7 +61,20 @@ void app_selector()
         if (choice > 0 && choice <= APP_COUNT)
         {
             clear_screen();
+            bool_t own_space = address_space_init(&app_address_space);
+            if (own_space)
+                address_space_switch(&app_address_space);
+            arena_init(&app_arena);
             apps[choice - 1].entry_point();
+            arena_destroy(&app_arena);
+            if (own_space)
+            {
+                address_space_switch(NULL);
+                address_space_destroy(&app_address_space);
+            }
+#ifdef HEAP_TRACE
+            heap_trace_drain();
+#endif
         }
         else
         {
@@ -1,3 +1,7 @@
 #pragma once
 
-void app_selector();
\ No newline at end of file
+#include <kernel/arena.h>
+
+void app_selector();
+
+arena_t *get_app_arena(void);
\ No newline at end of file
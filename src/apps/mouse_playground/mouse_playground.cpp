@@ -8,6 +8,7 @@ extern "C"
 #include <drivers/screen.h>
 #include <drivers/keyboard.h>
 #include <lib/string.h>
+#include <cpu.h>
 }
 
 static const char m1_text[] = " Great! Now mouse2 ";
@@ -44,7 +45,7 @@ void mouse_playground_main(void)
     {
         char c;
         while (!(c = get_keyboard_char()))
-            asm volatile("hlt");
+            cpu_idle();
         if (c == KEY_ESC)
         {
             reset_ui_structure();
@@ -7,6 +7,7 @@
 #include <lib/string.h>
 #include <lib/math_generic.h>
 #include <kernel/diagnostics/rsod_routine.h>
+#include <cpu.h>
 
 #define CRASHES_LEN (uint8_t)(sizeof(crashes) / sizeof(crashes[0]))
 #define COLORS_LEN (uint8_t)(sizeof(colors) / sizeof(colors[0]))
@@ -260,7 +261,7 @@ void rsod_roulette_main(void)
     {
         char c;
         while (!(c = get_keyboard_char()))
-            asm volatile("hlt");
+            cpu_idle();
         switch (c)
         {
         case KEY_ESC:
@@ -4,6 +4,7 @@
 #include <drivers/screen.h>
 #include <lib/string.h>
 #include <timer/pit.h>
+#include <cpu.h>
 
 static char buf[12];
 
@@ -173,7 +174,7 @@ void segment_test_main(void)
 
         char c;
         while (!(c = get_keyboard_char()))
-            asm volatile("hlt");
+            cpu_idle();
 
         switch (c)
         {
@@ -14,6 +14,7 @@ extern "C"
 #include <lib/string.h>
 #include <lib/math.h>
 #include <drivers/qemu_serial.h>
+#include <cpu.h>
 #ifdef __cplusplus
 }
 #endif
@@ -397,7 +398,7 @@ restart_settings_manager:
         while (!(keyboard_input))
         {
             keyboard_input = get_keyboard_char();
-            asm volatile("hlt");
+            cpu_idle();
         }
 
         option_t *current_opt = &options[selected_option + current_page * (OPTIONS_IN_COLLUM * 2)];
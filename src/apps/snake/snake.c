@@ -8,6 +8,7 @@
 #include <timer/pit.h>
 #include <drivers/screen.h>
 #include <drivers/keyboard.h>
+#include <cpu.h>
 
 #define FIELD_HEIGHT 25
 #define FIELD_WIDTH 80
@@ -115,7 +116,7 @@ restart:
                 ticks_on_last_automove = get_timer_ticks();
                 break;
             }
-            asm volatile("hlt");
+            cpu_idle();
         }
         switch (c)
         {
@@ -171,7 +172,7 @@ restart:
             while (true)
             {
                 while (!(c = get_keyboard_char()))
-                    asm volatile("hlt");
+                    cpu_idle();
                 switch (c)
                 {
                 case KEY_ESC:
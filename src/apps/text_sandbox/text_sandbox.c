@@ -4,6 +4,7 @@
 #include <drivers/keyboard.h>
 #include <drivers/screen.h>
 #include <lib/string.h>
+#include <cpu.h>
 
 void text_sandbox_main()
 {
@@ -21,7 +22,7 @@ void text_sandbox_main()
     {
         char c;
         while (!(c = get_keyboard_char()))
-            asm volatile("hlt");
+            cpu_idle();
 
         switch (c)
         {
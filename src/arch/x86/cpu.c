@@ -0,0 +1,12 @@
+#include <cpu.h>
+#include <paging/paging.h>
+
+/* body of every wait-for-interrupt loop. Idle time first goes to zeroing frames ahead,
+callers recheck their condition either way */
+void cpu_idle(void)
+{
+    if (refill_zero_pool())
+        return;
+
+    asm volatile("hlt");
+}
@@ -1,5 +1,6 @@
 #include <interrupts/isr.h>
 #include <kernel/diagnostics/rsod_routine.h>
+#include <paging/vm_region.h>
 
 #define DEFINE_UNSPECIAL_ISR(n, msg)                 \
     _Noreturn void isr_##n(const cpu_state_t *state) \
@@ -23,7 +24,6 @@ DEFINE_UNSPECIAL_ISR(9, "Coprocessor Segment Overrun");
 DEFINE_UNSPECIAL_ISR(11, "Segment Not Present");
 DEFINE_UNSPECIAL_ISR(12, "Stack Segment Fault"); // TODO reimplement after Rings system will be implemented(also special common isr needed)
 DEFINE_UNSPECIAL_ISR(13, "General Protection Fault");
-DEFINE_UNSPECIAL_ISR(14, "Page Fault");
 DEFINE_UNSPECIAL_ISR(16, "FPU Floating-Point Error");
 DEFINE_UNSPECIAL_ISR(17, "Unaligned data operation");
 DEFINE_UNSPECIAL_ISR(18, "Machine Check - CPU Hardware Failure");
@@ -55,6 +55,20 @@ _Noreturn void isr_7(const cpu_state_t *state)
     show_rsod("Coprocessor Not Ready", state, 7);
     __builtin_unreachable();
 }
+/* 14 Page Fault - resolved by the vm_region handler: kernel PDE sync, copy-on-write and
+zero page breaks, demand-zero regions. Anything else ends in RSOD */
+void isr_14(const cpu_state_t *state)
+{
+    uint32_t fault_addr;
+    asm volatile("mov %%cr2, %0" : "=r"(fault_addr));
+
+    if (handle_page_fault(fault_addr, state->err_code))
+        return;
+
+    show_rsod("Page Fault", state, 14);
+    __builtin_unreachable();
+}
+
 /* 48 Stack Overflow - Custom Stack Guard Exception */
 _Noreturn void isr_48(const cpu_state_t *state)
 {
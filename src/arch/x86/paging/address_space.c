@@ -0,0 +1,65 @@
+#include <paging/address_space.h>
+#include <paging/paging.h>
+#include <cpu.h>
+
+bool_t address_space_init(address_space_t *as)
+{
+    uint32_t pd_phys = alloc_frame();
+    if (!pd_phys)
+        return false;
+
+    // no kernel PDE may change between the copy and tracking
+    uint32_t eflags = irq_save();
+    if (!track_page_directory(pd_phys))
+    {
+        irq_restore(eflags);
+        free_frame(pd_phys);
+        return false;
+    }
+
+    map_page(TEMP_PD_VADDR, pd_phys, PAGE_PRESENT | PAGE_RW);
+    volatile pde_t *pd = (volatile pde_t *)TEMP_PD_VADDR;
+
+    for (uint32_t i = 0; i < KERNEL_PDE_START; i++)
+        pd[i].raw_data = 0;
+
+    for (uint32_t i = KERNEL_PDE_START; i < RECURSIVE_PDE; i++)
+        pd[i].raw_data = kernel_page_directory[i].raw_data;
+
+    pd[RECURSIVE_PDE].raw_data = 0;
+    pd[RECURSIVE_PDE].fields.addr = pd_phys >> 12;
+    pd[RECURSIVE_PDE].fields.present = 1;
+    pd[RECURSIVE_PDE].fields.rw = 1;
+
+    unmap_page(TEMP_PD_VADDR);
+    irq_restore(eflags);
+
+    as->pd_phys = pd_phys;
+    return true;
+}
+
+void address_space_switch(address_space_t *as)
+{
+    uint32_t pd_phys = as ? as->pd_phys : get_kernel_page_directory_phys();
+    if (pd_phys != get_current_page_directory_phys())
+        load_page_directory_phys(pd_phys);
+}
+
+// user half is reached through the recursive mapping, so the PD is loaded while it is torn down
+void address_space_destroy(address_space_t *as)
+{
+    if (!as->pd_phys)
+        return;
+
+    uint32_t prev_pd = get_current_page_directory_phys();
+    if (prev_pd == as->pd_phys)
+        prev_pd = get_kernel_page_directory_phys();
+
+    load_page_directory_phys(as->pd_phys);
+    unmap_range(0, KERNEL_PDE_START * PAGES_PER_TABLE, true);
+    load_page_directory_phys(prev_pd);
+
+    untrack_page_directory(as->pd_phys);
+    free_frame(as->pd_phys);
+    as->pd_phys = 0;
+}
@@ -2,11 +2,13 @@ section .bootstrap
 
 global bootstrap_enable_paging
 global bootstrap_enable_global_pages
+global bootstrap_enable_large_pages
+global bootstrap_setup_pat
 global bootstrap_load_page_directory
 
 bootstrap_enable_paging:
     mov eax, cr0
-    or eax, 1 << 31
+    or eax, (1 << 31) | (1 << 16) ; PG, WP - ring 0 writes fault on read-only pages too (copy-on-write)
     mov cr0, eax
 
     ret
@@ -18,6 +20,32 @@ bootstrap_enable_global_pages:
 
     ret
 
+bootstrap_enable_large_pages:
+    mov eax, cr4
+    or eax, 1 << 4
+    mov cr4, eax
+
+    ret
+
+; PAT entry 1 (PWT=1 PCD=0) becomes write-combining instead of write-through.
+; Runs before paging is enabled, so no cached translations or lines use the old type
+bootstrap_setup_pat:
+    push ebx
+    mov eax, 1
+    cpuid
+    pop ebx
+    test edx, 1 << 16 ; CPUID.01h:EDX.PAT
+    jz .no_pat
+
+    mov ecx, 0x277 ; IA32_PAT
+    rdmsr
+    and eax, ~(0x7 << 8)
+    or eax, 0x01 << 8 ; PA1 = WC
+    wrmsr
+
+.no_pat:
+    ret
+
 bootstrap_load_page_directory:
     mov eax, [esp+4]
     mov cr3, eax
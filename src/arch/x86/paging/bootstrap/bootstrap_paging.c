@@ -7,6 +7,8 @@
 
 __attribute__((section(".bootstrap"))) extern void bootstrap_load_page_directory(pde_t page_dir[1024]);
 __attribute__((section(".bootstrap"))) extern void bootstrap_enable_global_pages(void);
+__attribute__((section(".bootstrap"))) extern void bootstrap_enable_large_pages(void);
+__attribute__((section(".bootstrap"))) extern void bootstrap_setup_pat(void);
 __attribute__((section(".bootstrap"))) extern void bootstrap_enable_paging(void);
 
 __attribute__((section(".bootstrap.data"), aligned(4096))) pde_t bootstrap_page_directory[1024] = {0};
@@ -66,7 +68,8 @@ __attribute__((section(".bootstrap"))) static void bootstrap_remap_vga_vram(void
 
     for (int i = 0; phys <= VGA_PHYS_END; i++, phys += 0x1000, virt += 0x1000)
     {
-        pte_init(&bootstrap_page_table_vga_vram[i], phys, 1, 0, 0, 1, 0, 1, 0);
+        // PWT selects PAT entry 1, write-combining after bootstrap_setup_pat (write-through without PAT)
+        pte_init(&bootstrap_page_table_vga_vram[i], phys, 1, 0, 1, 0, 0, 1, 0);
     }
 }
 
@@ -79,9 +82,10 @@ __attribute__((section(".bootstrap"))) void bootstrap_setup_mapping(void)
     {
         pte_init(&bootstrap_page_table[i], i * PAGE_LEN, 1, 0, 0, 0, 0, 0, 0);
 
-        pte_init(&bootstrap_page_table_kernel[i], KERNEL_PHYS_BASE + i * PAGE_LEN, 1, 0, 0, 0, 0, 0, 0);
+        // high-half mappings are the same in every address space, keep them in TLB across CR3 reloads
+        pte_init(&bootstrap_page_table_kernel[i], KERNEL_PHYS_BASE + i * PAGE_LEN, 1, 0, 0, 0, 0, 1, 0);
 
-        pte_init(&bootstrap_page_table_vga_vram[i], VGA_PHYS_START + i * PAGE_LEN, 1, 0, 0, 0, 0, 0, 0);
+        pte_init(&bootstrap_page_table_vga_vram[i], VGA_PHYS_START + i * PAGE_LEN, 1, 0, 0, 0, 0, 1, 0);
     }
 
     pde_init(&bootstrap_page_directory[0], (uint32_t)bootstrap_page_table, 1, 1, 0, 0, 0, 0);
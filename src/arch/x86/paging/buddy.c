@@ -0,0 +1,137 @@
+#include <paging/buddy.h>
+#include <paging/paging.h>
+
+static hbitmap_t free_blocks[BUDDY_ORDERS]; // bit i of order k = frames [i << k, (i + 1) << k) are free
+static uint32_t free_frame_count = 0;
+static uint32_t total_frames = 0;
+
+/* storage must hold BUDDY_STORAGE_WORDS(frames) words.
+Only whole blocks get a bit, the tail that does not fill a block of given order is never merged up to it */
+void buddy_init(uint32_t frames, uint32_t *storage)
+{
+    for (uint32_t order = 0; order < BUDDY_ORDERS; order++)
+    {
+        uint32_t bits = frames >> order;
+        hbitmap_init(&free_blocks[order], storage, bits);
+        storage += HBITMAP_WORDS(bits);
+    }
+    free_frame_count = 0;
+    total_frames = frames;
+}
+
+int32_t buddy_alloc(uint32_t order)
+{
+    if (order > BUDDY_MAX_ORDER)
+        return -1;
+
+    for (uint32_t k = order; k < BUDDY_ORDERS; k++)
+    {
+        int32_t block = hbitmap_find_first(&free_blocks[k]);
+        if (block < 0)
+            continue;
+
+        hbitmap_clear(&free_blocks[k], block);
+
+        // split down, lower half is kept, upper half goes to the free bitmap of the order below
+        uint32_t index = block;
+        while (k > order)
+        {
+            k--;
+            index <<= 1;
+            hbitmap_set(&free_blocks[k], index + 1);
+        }
+
+        free_frame_count -= 1u << order;
+        return index << order;
+    }
+    return -1;
+}
+
+void buddy_free(uint32_t frame, uint32_t order)
+{
+    free_frame_count += 1u << order;
+
+    uint32_t index = frame >> order;
+    while (order < BUDDY_MAX_ORDER)
+    {
+        uint32_t buddy = index ^ 1;
+        if (buddy >= free_blocks[order].bits || !hbitmap_get(&free_blocks[order], buddy))
+            break;
+
+        hbitmap_clear(&free_blocks[order], buddy);
+        index >>= 1;
+        order++;
+    }
+    hbitmap_set(&free_blocks[order], index);
+}
+
+void buddy_free_range(uint32_t frame, uint32_t count)
+{
+    while (count)
+    {
+        uint32_t order = frame ? __builtin_ctz(frame) : BUDDY_MAX_ORDER;
+        if (order > BUDDY_MAX_ORDER)
+            order = BUDDY_MAX_ORDER;
+        while ((1u << order) > count)
+            order--;
+
+        buddy_free(frame, order);
+        frame += 1u << order;
+        count -= 1u << order;
+    }
+}
+
+// takes given frames out of the free blocks, frames that are not free are skipped
+void buddy_reserve_range(uint32_t frame, uint32_t count)
+{
+    uint32_t end = frame + count < total_frames ? frame + count : total_frames;
+    while (frame < end)
+    {
+        uint32_t order = 0;
+        while (order < BUDDY_ORDERS)
+        {
+            uint32_t index = frame >> order;
+            if (index < free_blocks[order].bits && hbitmap_get(&free_blocks[order], index))
+                break;
+            order++;
+        }
+        if (order == BUDDY_ORDERS)
+        {
+            frame++;
+            continue;
+        }
+
+        uint32_t block_start = frame & ~((1u << order) - 1);
+        hbitmap_clear(&free_blocks[order], frame >> order);
+        free_frame_count -= 1u << order;
+
+        // whole block is inside the range
+        if (block_start == frame && frame + (1u << order) <= end)
+        {
+            frame += 1u << order;
+            continue;
+        }
+
+        // split down to the frame, halves not containing it stay free
+        while (order > 0)
+        {
+            order--;
+            hbitmap_set(&free_blocks[order], (frame >> order) ^ 1);
+            free_frame_count += 1u << order;
+        }
+        frame++;
+    }
+}
+
+uint32_t buddy_free_frames(void)
+{
+    return free_frame_count;
+}
+
+uint32_t buddy_order_for(uint32_t frames)
+{
+    uint32_t order = 0;
+    while ((1u << order) < frames)
+        order++;
+    return order;
+}
@@ -0,0 +1,92 @@
+#include <paging/frame_ref.h>
+
+typedef struct
+{
+    uint32_t frame; // frame index + 1, 0 = empty slot
+    uint32_t count;
+} frame_ref_t;
+
+// open addressing with linear probing
+static frame_ref_t refs[FRAME_REF_TABLE_SIZE];
+static uint32_t ref_count = 0;
+
+static inline uint32_t ref_hash(uint32_t key)
+{
+    return (key * 2654435761u) & (FRAME_REF_TABLE_SIZE - 1);
+}
+
+static frame_ref_t *ref_find(uint32_t key)
+{
+    for (uint32_t i = ref_hash(key);; i = (i + 1) & (FRAME_REF_TABLE_SIZE - 1))
+    {
+        if (refs[i].frame == key)
+            return &refs[i];
+        if (!refs[i].frame)
+            return NULL;
+    }
+}
+
+// removes slot and moves later entries of the probe chain back, so lookups need no tombstones
+static void ref_remove(frame_ref_t *slot)
+{
+    uint32_t hole = slot - refs;
+    uint32_t i = hole;
+    while (true)
+    {
+        i = (i + 1) & (FRAME_REF_TABLE_SIZE - 1);
+        if (!refs[i].frame)
+            break;
+
+        uint32_t home = ref_hash(refs[i].frame);
+        // entry may fill the hole only if its home is not between the hole and itself
+        if (((i - home) & (FRAME_REF_TABLE_SIZE - 1)) >= ((i - hole) & (FRAME_REF_TABLE_SIZE - 1)))
+        {
+            refs[hole] = refs[i];
+            hole = i;
+        }
+    }
+    refs[hole].frame = 0;
+    refs[hole].count = 0;
+    ref_count--;
+}
+
+bool_t frame_ref_share(uint32_t phys)
+{
+    uint32_t key = (phys >> 12) + 1;
+    frame_ref_t *ref = ref_find(key);
+    if (ref)
+    {
+        ref->count++;
+        return true;
+    }
+
+    // keep one slot empty so probing always ends
+    if (ref_count == FRAME_REF_TABLE_SIZE - 1)
+        return false;
+
+    uint32_t i = ref_hash(key);
+    while (refs[i].frame)
+        i = (i + 1) & (FRAME_REF_TABLE_SIZE - 1);
+
+    refs[i].frame = key;
+    refs[i].count = 2;
+    ref_count++;
+    return true;
+}
+
+bool_t frame_ref_put(uint32_t phys)
+{
+    frame_ref_t *ref = ref_find((phys >> 12) + 1);
+    if (!ref)
+        return true;
+
+    if (--ref->count == 1)
+        ref_remove(ref);
+    return false;
+}
+
+uint32_t frame_ref_count(uint32_t phys)
+{
+    frame_ref_t *ref = ref_find((phys >> 12) + 1);
+    return ref ? ref->count : 1;
+}
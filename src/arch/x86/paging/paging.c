@@ -2,49 +2,85 @@
 #include <paging/page_table.h>
 #include <paging/page_directory.h>
 #include <paging/gdt.h>
-#include <lib/arrlib.h>
+#include <paging/buddy.h>
+#include <paging/e820.h>
+#include <paging/frame_ref.h>
+#include <cpu.h>
 #include <lib/mem.h>
 
 #include <drivers/qemu_serial.h>
 
-static uint8_t avl_phys_pages_bitmap[TOTAL_FRAMES / 8] = {0};
-static uint32_t last_avl_frame_index = 0;
+static e820_entry_t memory_map[E820_MAX_ENTRIES];
+static uint32_t memory_map_count = 0;
+static uint32_t frame_count = 0; // frames up to the end of the highest usable RAM range
 
-static void set_alv_frame(uint32_t index, bool_t val)
-{
-    if (!val)
-    {
-        if (index < last_avl_frame_index)
-            last_avl_frame_index = index;
-    }
-    set_bitmap8_val(avl_phys_pages_bitmap, index, val);
-}
-static bool_t get_alv_frame(uint32_t index)
-{
-    bool_t val = get_bitmap8_val(avl_phys_pages_bitmap, index);
-    if (!val)
-    {
-        if (index < last_avl_frame_index)
-            last_avl_frame_index = index;
-    }
+/* LIFO of recently freed single frames in front of the buddy allocator.
+The top is the most recently freed, still cache warm frame. Filled from the
+buddy allocator with one order FRAME_CACHE_BATCH_ORDER block when empty,
+the oldest batch is given back when full */
+#define FRAME_CACHE_SIZE 64
+#define FRAME_CACHE_BATCH_ORDER 4
+#define FRAME_CACHE_BATCH (1u << FRAME_CACHE_BATCH_ORDER)
 
-    return val;
-}
+static uint32_t frame_cache[FRAME_CACHE_SIZE]; // frame indices
+static uint32_t frame_cache_count = 0;
+
+/* PHYSICAL frames zeroed ahead of time for new page tables, demand-zero faults and
+copy-on-write breaks of the zero frame. cpu_idle starts topping the pool up once it
+drops below ZERO_POOL_LOW and keeps going until it is full, a few frames per call */
+#define ZERO_POOL_SIZE 32
+#define ZERO_POOL_LOW 8
+#define ZERO_POOL_IDLE_BATCH 4
+
+static uint32_t zero_pool[ZERO_POOL_SIZE];
+static uint32_t zero_pool_count = 0;
+static bool_t zero_pool_refilling = false;
+
+static uint32_t zero_frame = 0; // PHYSICAL frame shared read-only by all map_zero_range mappings
+
+// unmap_range flushes bigger ranges with one TLB flush instead of invlpg per page
+#define UNMAP_INVLPG_MAX_PAGES 32
 
 static gdt_entry_t kernel_gdt[6] = {0};
 static gdt_ptr_t gp;
 
 extern void load_page_directory_extern(pde_t page_dir[1024]);
 
+static uint32_t kernel_pd_phys = 0;
+static uint32_t current_pd_phys = 0;
+
+// PHYSICAL PDs of address spaces, kernel half PDE changes are copied into each
+#define TRACKED_PD_MAX 16
+static uint32_t tracked_pds[TRACKED_PD_MAX];
+static uint32_t tracked_pd_count = 0;
+
+// switches to PD at given PHYSICAL address, global kernel TLB entries survive
+void load_page_directory_phys(uint32_t pd_phys)
+{
+    current_pd_phys = pd_phys;
+    load_page_directory_extern((pde_t *)pd_phys);
+}
+
 void load_page_directory(pde_t page_dir[1024])
 {
 
     if ((uint32_t)page_dir < 0xC0000000)
-        load_page_directory_extern(page_dir);
+        load_page_directory_phys((uint32_t)page_dir);
     else
-        load_page_directory_extern(vir_to_phys_addr(page_dir));
+        load_page_directory_phys((uint32_t)vir_to_phys_addr(page_dir));
+}
+
+uint32_t get_current_page_directory_phys(void)
+{
+    return current_pd_phys;
+}
+
+uint32_t get_kernel_page_directory_phys(void)
+{
+    return kernel_pd_phys;
 }
 
+// kernel PD stays mapped at KERNEL_PD_VADDR, so kernel PDEs are reachable from every address space
 pde_t *kernel_page_directory = NULL;
 
 extern pde_t bootstrap_page_directory[1024];
@@ -57,96 +93,125 @@ static inline void flush_tlb(void)
     asm volatile("mov %0, %%cr3" ::"r"(cr3));
 }
 
+// drops every TLB entry, global ones included, by toggling CR4.PGE
+void flush_tlb_global(void)
+{
+    uint32_t cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    asm volatile("mov %0, %%cr4" ::"r"(cr4 & ~CR4_PGE) : "memory");
+    asm volatile("mov %0, %%cr4" ::"r"(cr4) : "memory");
+}
+
+// kernel half is shared by every address space, so its pages are global
+static inline bool_t is_global_virt(uint32_t virt)
+{
+    return virt >= KERNEL_VMA;
+}
+
 // apply PDE changes in PD for specific addr
 static inline void invlpg(void *addr)
 {
     asm volatile("invlpg (%0)" ::"r"(addr) : "memory");
 }
 
-// returns PHYSICAL addres of avaible frame
-uint32_t alloc_frame(void)
+static void refill_frame_cache(void)
 {
-    for (uint32_t i = last_avl_frame_index; i < TOTAL_FRAMES; ++i)
+    int32_t block = buddy_alloc(FRAME_CACHE_BATCH_ORDER);
+    if (block >= 0)
     {
-        if (!get_alv_frame(i))
-        {
-            set_alv_frame(i, true);
-            return i * PAGE_SIZE;
-        }
+        // lowest frame ends on top
+        for (uint32_t i = FRAME_CACHE_BATCH; i > 0; i--)
+            frame_cache[frame_cache_count++] = block + i - 1;
+        return;
     }
-    return 0;
+
+    // no whole block left, take what single frames there are
+    while (frame_cache_count < FRAME_CACHE_BATCH)
+    {
+        int32_t frame = buddy_alloc(0);
+        if (frame < 0)
+            return;
+        frame_cache[frame_cache_count++] = frame;
+    }
+}
+
+// gives given number of the oldest cached frames back to the buddy allocator
+static void drain_frame_cache(uint32_t count)
+{
+    if (count > frame_cache_count)
+        count = frame_cache_count;
+
+    for (uint32_t i = 0; i < count; i++)
+        buddy_free(frame_cache[i], 0);
+
+    frame_cache_count -= count;
+    memmove(frame_cache, frame_cache + count, frame_cache_count * sizeof(uint32_t));
+}
+
+// returns PHYSICAL addres of a frame from the frame cache or the buddy allocator, never from the zero pool
+static uint32_t alloc_cached_frame(void)
+{
+    if (!frame_cache_count)
+        refill_frame_cache();
+    if (!frame_cache_count)
+        return 0;
+
+    return frame_cache[--frame_cache_count] * PAGE_SIZE;
+}
+
+// returns PHYSICAL addres of avaible frame
+uint32_t alloc_frame(void)
+{
+    uint32_t phys = alloc_cached_frame();
+    if (!phys && zero_pool_count)
+        return zero_pool[--zero_pool_count]; // last resort, zeroing was wasted
+    return phys;
 }
 
 /*
- * Quick search for N contiguous frames.
+ * Allocates N contiguous frames from the buddy allocator.
+ * The request is rounded up to a power of two block and the tail past N frames is given back,
+ * so the range is freed later frame by frame or with free_contiguous_frames.
  * Returns the physical address of the first frame (phys = start_frame * PAGE_SIZE),
  * or 0 if not found.
  */
 uint32_t alloc_contiguous_frames(uint32_t pages)
 {
-    if (pages == 0 || pages > TOTAL_FRAMES)
+    if (pages == 0 || pages > (1u << BUDDY_MAX_ORDER))
     {
         serial_write_uint32(pages);
         serial_write_str("\nalloc_contiguous_frames validation catch\n");
         return 0;
     }
 
-    uint32_t run = 0;
-    uint32_t start = 0;
-
-    for (uint32_t i = last_avl_frame_index; i < TOTAL_FRAMES; ++i)
+    uint32_t order = buddy_order_for(pages);
+    int32_t start = buddy_alloc(order);
+    if (start < 0)
     {
-        if (!get_alv_frame(i))
-        {
-            if (run == 0)
-                start = i;
-            ++run;
-            if (run >= pages)
-            {
-                for (uint32_t j = start; j < start + pages; ++j)
-                    set_alv_frame(j, true);
-                return start * PAGE_SIZE;
-            }
-        }
-        else
-        {
-            run = 0;
-        }
+        // cached frames may be what keeps buddies from merging
+        drain_frame_cache(frame_cache_count);
+        start = buddy_alloc(order);
+        if (start < 0)
+            return 0;
     }
 
-    for (uint32_t i = 0; i < last_avl_frame_index; ++i)
-    {
-        if (!get_alv_frame(i))
-        {
-            if (run == 0)
-                start = i;
-            ++run;
-            if (run >= pages)
-            {
-                for (uint32_t j = start; j < start + pages; ++j)
-                    set_alv_frame(j, true);
-                return start * PAGE_SIZE;
-            }
-        }
-        else
-        {
-            run = 0;
-        }
-    }
-
-    return 0;
+    buddy_free_range(start + pages, (1u << order) - pages);
+    return start * PAGE_SIZE;
 }
 
 // set page that phys addr came from as avaible
 void free_frame(uint32_t phys_addr)
 {
-    set_alv_frame(phys_addr / PAGE_SIZE, false);
+    if (frame_cache_count == FRAME_CACHE_SIZE)
+        drain_frame_cache(FRAME_CACHE_BATCH);
+
+    frame_cache[frame_cache_count++] = phys_addr / PAGE_SIZE;
 }
 
-// returns PHYSICAL addres of avaible frame
-static uint32_t alloc_page_table_phys(void)
+// gives back range taken by alloc_contiguous_frames
+void free_contiguous_frames(uint32_t phys_addr, uint32_t pages)
 {
-    return alloc_frame();
+    buddy_free_range(phys_addr / PAGE_SIZE, pages);
 }
 
 // returns PHYSICAL addres of avaible frame
@@ -181,8 +246,153 @@ static inline volatile pte_t *get_pte(uint32_t virt)
     return &get_pt_virt(pd_index)[pt_index];
 }
 
-// creates new page table entry in PD and returns VIRTUAL pointer to the PT
-volatile pte_t *alloc_page_table_virtual(uint32_t pd_index, uint32_t phys_pt)
+/* PDE of the kernel half changed in the current PD, it is copied to the kernel PD and every
+other tracked address space so none keeps a replaced page table or 4 MiB page */
+static void publish_kernel_pde(uint32_t pd_index)
+{
+    if (!kernel_page_directory)
+        return;
+    if (pd_index < KERNEL_PDE_START || pd_index >= RECURSIVE_PDE)
+        return;
+
+    uint32_t pde = get_pd_virt()[pd_index].raw_data;
+    if (current_pd_phys != kernel_pd_phys)
+        kernel_page_directory[pd_index].raw_data = pde;
+
+    uint32_t eflags = irq_save(); // TEMP_PD_VADDR is shared with address_space_init
+    bool_t mapped = false;
+    for (uint32_t i = 0; i < tracked_pd_count; i++)
+    {
+        if (tracked_pds[i] == current_pd_phys)
+            continue;
+        map_page(TEMP_PD_VADDR, tracked_pds[i], PAGE_PRESENT | PAGE_RW);
+        ((volatile pde_t *)TEMP_PD_VADDR)[pd_index].raw_data = pde;
+        mapped = true;
+    }
+    if (mapped)
+        unmap_page(TEMP_PD_VADDR);
+    irq_restore(eflags);
+}
+
+// PD of an address space starts getting kernel half PDE changes. Returns false if too many are tracked
+bool_t track_page_directory(uint32_t pd_phys)
+{
+    if (tracked_pd_count == TRACKED_PD_MAX)
+        return false;
+    tracked_pds[tracked_pd_count++] = pd_phys;
+    return true;
+}
+
+void untrack_page_directory(uint32_t pd_phys)
+{
+    for (uint32_t i = 0; i < tracked_pd_count; i++)
+    {
+        if (tracked_pds[i] != pd_phys)
+            continue;
+        tracked_pds[i] = tracked_pds[--tracked_pd_count];
+        return;
+    }
+}
+
+/* kernel half PDE of a foreign address space is not present or differs from the kernel PD:
+the kernel PD entry is copied. Returns false if there is nothing to sync */
+bool_t sync_kernel_pde(uint32_t virt)
+{
+    uint32_t pd_index = virt >> 22;
+    if (!kernel_page_directory || current_pd_phys == kernel_pd_phys)
+        return false;
+    if (pd_index < KERNEL_PDE_START || pd_index >= RECURSIVE_PDE)
+        return false;
+
+    volatile pde_t *pde = get_pd_virt() + pd_index;
+    if (pde->raw_data == kernel_page_directory[pd_index].raw_data || !kernel_page_directory[pd_index].fields.present)
+        return false;
+
+    pde->raw_data = kernel_page_directory[pd_index].raw_data;
+    invlpg((void *)virt);
+    invlpg((void *)get_pt_virt(pd_index));
+    return true;
+}
+
+static void *map_temp_frame(uint32_t phys);
+static void unmap_temp_frame(void);
+
+// TEMP_COPY_VADDR window can be used once its page table exists
+static bool_t temp_window_ready(void)
+{
+    volatile pde_t *window = get_pde(TEMP_COPY_VADDR);
+    return window->fields.present && !window->fields.ps;
+}
+
+/* zeroes frame at given PHYSICAL address through the TEMP_COPY_VADDR window.
+Interrupts are off while the window is used, fault handlers and idle refill share it */
+static void clear_frame(uint32_t phys)
+{
+    uint32_t eflags = irq_save();
+    memset(map_temp_frame(phys), 0, PAGE_SIZE);
+    unmap_temp_frame();
+    irq_restore(eflags);
+}
+
+/* idle time work: zeroes at most ZERO_POOL_IDLE_BATCH frames into the pool once it is
+below ZERO_POOL_LOW, until it is full. Interrupts are off per frame, fault handlers take
+frames from the pool too. Returns true while the pool still wants more frames */
+bool_t refill_zero_pool(void)
+{
+    if (!zero_pool_refilling && zero_pool_count >= ZERO_POOL_LOW)
+        return false;
+    if (!temp_window_ready())
+        return false;
+
+    zero_pool_refilling = true;
+    for (uint32_t i = 0; i < ZERO_POOL_IDLE_BATCH && zero_pool_count < ZERO_POOL_SIZE; i++)
+    {
+        uint32_t eflags = irq_save();
+        uint32_t phys = alloc_cached_frame(); // a frame of the pool would only go round in circles
+        if (phys)
+        {
+            clear_frame(phys);
+            zero_pool[zero_pool_count++] = phys;
+        }
+        irq_restore(eflags);
+
+        if (!phys)
+        {
+            zero_pool_refilling = false;
+            return false;
+        }
+    }
+
+    if (zero_pool_count == ZERO_POOL_SIZE)
+        zero_pool_refilling = false;
+    return zero_pool_refilling;
+}
+
+// returns PHYSICAL addres of a zeroed frame, taken from the pool or zeroed on the spot
+uint32_t alloc_zeroed_frame(void)
+{
+    if (zero_pool_count)
+        return zero_pool[--zero_pool_count];
+
+    uint32_t phys = alloc_frame();
+    if (phys)
+        clear_frame(phys);
+    return phys;
+}
+
+/* returns PHYSICAL addres of avaible frame for a page table, `zeroed` tells
+if it came from the zero pool. Otherwise it is zeroed once mapped */
+static uint32_t alloc_page_table_phys(bool_t *zeroed)
+{
+    *zeroed = zero_pool_count != 0;
+    if (zero_pool_count)
+        return zero_pool[--zero_pool_count];
+    return alloc_frame();
+}
+
+/* creates new page table entry in PD and returns VIRTUAL pointer to the PT.
+Only the recursive mapping of the table is invalidated, the range had no 4 KiB translations */
+volatile pte_t *alloc_page_table_virtual(uint32_t pd_index, uint32_t phys_pt, bool_t zeroed)
 {
     volatile pde_t *pd = get_pd_virt();
     pd[pd_index].fields.addr = phys_pt >> 12;
@@ -190,41 +400,150 @@ volatile pte_t *alloc_page_table_virtual(uint32_t pd_index, uint32_t phys_pt)
     pd[pd_index].fields.rw = 1;
     pd[pd_index].fields.us = 0;
 
-    uint32_t cr3;
-    asm volatile("mov %%cr3, %0" : "=r"(cr3));
-    asm volatile("mov %0, %%cr3" ::"r"(cr3));
-
     volatile pte_t *pt = get_pt_virt(pd_index);
-    for (int i = 0; i < 1024; i++)
+    invlpg((void *)pt);
+
+    if (!zeroed)
+        memset((void *)pt, 0, PAGE_SIZE);
+
+    publish_kernel_pde(pd_index);
+    return pt;
+}
+
+/* replaces 4 MiB page at given PD index with a page table mapping the same frames.
+Returns VIRTUAL pointer to the PT or NULL if there is no frame for it */
+static volatile pte_t *split_large_page(uint32_t pd_index)
+{
+    bool_t zeroed;
+    uint32_t pt_phys = alloc_page_table_phys(&zeroed);
+    if (!pt_phys)
+        return NULL;
+
+    volatile pde_t *pde = get_pd_virt() + pd_index;
+    pde_t large = *(pde_t *)pde;
+
+    // the range is unmapped until the table is filled
+    pde->raw_data = 0;
+    volatile pte_t *pt = alloc_page_table_virtual(pd_index, pt_phys, zeroed);
+    pde->fields.rw = large.fields.rw;
+    pde->fields.us = large.fields.us;
+    publish_kernel_pde(pd_index);
+
+    uint32_t phys = large.fields.addr << 12;
+    for (uint32_t i = 0; i < PAGES_PER_TABLE; i++, phys += PAGE_SIZE)
     {
-        pt[i].raw_data = 0;
+        pt[i].fields.addr = phys >> 12;
+        pt[i].fields.present = 1;
+        pt[i].fields.rw = large.fields.rw;
+        pt[i].fields.us = large.fields.us;
+        pt[i].fields.pwt = large.fields.pwt;
+        pt[i].fields.pcd = large.fields.pcd;
+        pt[i].fields.dirty = large.fields.dirty;
+        pt[i].fields.global = large.fields.global;
     }
+    flush_tlb();
+
     return pt;
 }
 
-// maps given VIRTUAL page to PHYSICAL address with provided flags
-void map_page(uint32_t virt, uint32_t phys, uint32_t flags)
+/* returns POINTER to PTE for provided virtual address or NULL if its PD entry is not present.
+4 MiB page covering the address is split first when `split` is set, otherwise NULL is returned for it */
+static volatile pte_t *find_pte(uint32_t virt, bool_t split)
 {
     volatile pde_t *pde = get_pde(virt);
-    if (!pde->fields.present)
+    if (!pde->fields.present && !sync_kernel_pde(virt))
+        return NULL;
+
+    if (pde->fields.ps && (!split || !split_large_page(virt >> 22)))
+        return NULL;
+
+    return get_pte(virt);
+}
+
+/* returns POINTER to PTE for provided virtual address, allocating its page table
+or splitting 4 MiB page covering it if needed. NULL if there is no frame for the table */
+static volatile pte_t *ensure_pte(uint32_t virt)
+{
+    volatile pde_t *pde = get_pde(virt);
+    // kernel half table may exist already, only not synced into this address space
+    if (!pde->fields.present && !sync_kernel_pde(virt))
     {
-        uint32_t pt_phys = alloc_page_table_phys();
-        alloc_page_table_virtual(virt >> 22, pt_phys);
+        bool_t zeroed;
+        uint32_t pt_phys = alloc_page_table_phys(&zeroed);
+        if (!pt_phys)
+            return NULL;
+        alloc_page_table_virtual(virt >> 22, pt_phys, zeroed);
     }
+    else if (pde->fields.ps && !split_large_page(virt >> 22))
+        return NULL;
+
+    return get_pte(virt);
+}
 
-    volatile pte_t *pte = get_pte(virt);
-    pte->fields.addr = phys >> 12;
-    pte->fields.present = 1;
-    pte->fields.rw = (flags & 2) != 0;
-    pte->fields.us = (flags & 4) != 0;
+static inline uint32_t make_pte(uint32_t virt, uint32_t phys, uint32_t flags)
+{
+    pte_t pte = {0};
+    pte.fields.addr = phys >> 12;
+    pte.fields.present = 1;
+    pte.fields.rw = (flags & PAGE_RW) != 0;
+    pte.fields.us = (flags & PAGE_USER) != 0;
+    pte.fields.pwt = (flags & PAGE_PWT) != 0;
+    pte.fields.pcd = (flags & PAGE_PCD) != 0;
+    pte.fields.global = is_global_virt(virt);
+    return pte.raw_data;
+}
+
+// maps given VIRTUAL page to PHYSICAL address with provided flags
+void map_page(uint32_t virt, uint32_t phys, uint32_t flags)
+{
+    volatile pte_t *pte = ensure_pte(virt);
+    if (!pte)
+        return;
+
+    pte->raw_data = make_pte(virt, phys, flags);
 
     asm volatile("invlpg (%0)" ::"r"(virt));
 }
 
+/* maps whole PD entry as one 4 MiB page, page table it pointed to is given back.
+Returns true if global translations may have been replaced, CR3 reload does not drop those */
+static bool_t map_large_page(uint32_t pd_index, uint32_t phys, uint32_t flags)
+{
+    volatile pde_t *pde = get_pd_virt() + pd_index;
+    bool_t replaced_global = false;
+    uint32_t old_table = 0;
+    if (!pde->fields.present)
+        sync_kernel_pde(pd_index << 22); // its page table must not be lost
+    if (pde->fields.present)
+    {
+        replaced_global = pde->fields.ps ? pde->fields.global : is_global_virt(pd_index << 22);
+        if (!pde->fields.ps)
+            old_table = pde->fields.addr << 12;
+    }
+
+    pde_t large = {0};
+    large.fields.addr = phys >> 12;
+    large.fields.present = 1;
+    large.fields.rw = (flags & PAGE_RW) != 0;
+    large.fields.us = (flags & PAGE_USER) != 0;
+    large.fields.pwt = (flags & PAGE_PWT) != 0;
+    large.fields.pcd = (flags & PAGE_PCD) != 0;
+    large.fields.ps = 1;
+    large.fields.global = is_global_virt(pd_index << 22);
+    pde->raw_data = large.raw_data;
+    // other address spaces point to kernel half tables until the new PDE is published
+    publish_kernel_pde(pd_index);
+    if (old_table)
+        free_frame(old_table);
+
+    return replaced_global;
+}
+
 /* * Batch mapping: map_range(virt_start, phys_start, pages, flags)
  * - Does NOT call invlpg for each page
- * - Allocates the page table only once per PD index
- * - Calls flush_tlb() once at the end */
+ * - Every whole PD entry with 4 MiB aligned virtual and physical address is mapped as one 4 MiB page
+ * - Otherwise allocates the page table only once per PD index
+ * - Calls flush_tlb() once at the end, or flush_tlb_global() if present global entries were replaced */
 void map_range(uint32_t virt_start, uint32_t phys_start, uint32_t pages, uint32_t flags)
 {
     if (pages == 0)
@@ -233,37 +552,47 @@ void map_range(uint32_t virt_start, uint32_t phys_start, uint32_t pages, uint32_
     uint32_t virt = virt_start;
     uint32_t phys = phys_start;
 
+    bool_t replaced_global = false;
     uint32_t pages_left = pages;
     while (pages_left > 0)
     {
         uint32_t pd_index = virt >> 22;
         uint32_t pt_index = (virt >> 12) & 0x3FF;
 
+        if (pt_index == 0 && !(phys & (LARGE_PAGE_SIZE - 1)) && pages_left >= PAGES_PER_TABLE)
+        {
+            replaced_global |= map_large_page(pd_index, phys, flags);
+            phys += LARGE_PAGE_SIZE;
+            virt += LARGE_PAGE_SIZE;
+            pages_left -= PAGES_PER_TABLE;
+            continue;
+        }
+
         uint32_t chunk = 1024 - pt_index;
         if (chunk > pages_left)
             chunk = pages_left;
 
         volatile pde_t *pde = get_pd_virt() + pd_index;
-        if (!pde->fields.present)
+        if (!pde->fields.present && !sync_kernel_pde(virt))
         {
-            uint32_t pt_phys = alloc_page_table_phys();
+            bool_t zeroed;
+            uint32_t pt_phys = alloc_page_table_phys(&zeroed);
             if (!pt_phys)
-            {
-                flush_tlb();
-                return;
-            }
-            alloc_page_table_virtual(pd_index, pt_phys);
+                break;
+            alloc_page_table_virtual(pd_index, pt_phys, zeroed);
         }
+        else if (pde->fields.ps && !split_large_page(pd_index))
+            break;
 
         volatile pte_t *pt = get_pt_virt(pd_index);
 
         for (uint32_t i = 0; i < chunk; ++i)
         {
             uint32_t idx = pt_index + i;
-            pt[idx].fields.addr = (phys >> 12);
-            pt[idx].fields.present = 1;
-            pt[idx].fields.rw = (flags & 2) != 0;
-            pt[idx].fields.us = (flags & 4) != 0;
+            if (pt[idx].fields.present && pt[idx].fields.global)
+                replaced_global = true;
+
+            pt[idx].raw_data = make_pte(virt, phys, flags);
 
             phys += PAGE_SIZE;
             virt += PAGE_SIZE;
@@ -271,41 +600,369 @@ void map_range(uint32_t virt_start, uint32_t phys_start, uint32_t pages, uint32_
         }
     }
 
-    flush_tlb();
+    if (replaced_global)
+        flush_tlb_global();
+    else
+        flush_tlb();
+}
+
+/* maps every page of the range to its own newly allocated frame. Page tables are set up
+once per PD index and no TLB flush is needed, the range must not be mapped before.
+On failure everything mapped so far is given back and false is returned */
+bool_t map_alloc_range(uint32_t virt_start, uint32_t pages, uint32_t flags)
+{
+    for (uint32_t i = 0; i < pages; i++)
+    {
+        uint32_t virt = virt_start + i * PAGE_SIZE;
+        volatile pte_t *pte = ensure_pte(virt);
+        uint32_t frame = pte ? alloc_frame() : 0;
+        if (!frame)
+        {
+            unmap_range(virt_start, i, true);
+            return false;
+        }
+
+        pte->raw_data = make_pte(virt, frame, flags);
+    }
+    return true;
 }
 
 // unmaps given VIRTUAL page if it is present in page table
 void unmap_page(uint32_t virt)
 {
-    volatile pte_t *pte = get_pte(virt);
-    if (pte->fields.present)
+    volatile pte_t *pte = find_pte(virt, true);
+    if (pte && pte->fields.present)
     {
         pte->raw_data = 0;
         asm volatile("invlpg (%0)" ::"r"(virt));
     }
 }
 
-// creates new page directory, initializes self-mapping, returns VIRTUAL PD address
-volatile pde_t *create_page_directory(void)
+// gives frame of a PTE that is being cleared back, shared copy-on-write frames only lose one reference
+static void put_pte_frame(pte_t pte)
+{
+    uint32_t phys = pte.fields.addr << 12;
+    if (pte.fields.avl & PAGE_AVL_COW)
+    {
+        if (phys == zero_frame || !frame_ref_put(phys))
+            return;
+    }
+    free_frame(phys);
+}
+
+// true if no entry of page table at given PD index is present
+static bool_t page_table_empty(uint32_t pd_index)
 {
-    uint32_t phys_pd = alloc_page_directory_phys();
+    volatile pte_t *pt = get_pt_virt(pd_index);
+    for (uint32_t i = 0; i < PAGES_PER_TABLE; i++)
+        if (pt[i].fields.present)
+            return false;
+    return true;
+}
 
-    volatile pde_t *pd_temp = (volatile pde_t *)TEMP_PD_VADDR;
+/* * Batch unmapping: unmap_range(virt_start, pages, free_frames)
+ * - Clears PTEs of the range, with free_frames the mapped frames go back to the frame allocator
+ * - Page tables left without present entries are freed
+ * - Ranges up to UNMAP_INVLPG_MAX_PAGES pages are flushed with invlpg per page,
+ *   bigger ones with one CR3 reload, or flush_tlb_global() if global entries were removed */
+void unmap_range(uint32_t virt_start, uint32_t pages, bool_t free_frames)
+{
+    if (pages == 0)
+        return;
 
-    map_page(TEMP_PD_VADDR, phys_pd, PAGE_PRESENT | PAGE_RW);
+    bool_t use_invlpg = pages <= UNMAP_INVLPG_MAX_PAGES;
+    bool_t removed_global = false;
 
-    for (int i = 0; i < 1024; i++)
-        pd_temp[i].raw_data = 0;
+    uint32_t virt = virt_start;
+    uint32_t pages_left = pages;
+    while (pages_left > 0)
+    {
+        uint32_t pd_index = virt >> 22;
+        uint32_t pt_index = (virt >> 12) & 0x3FF;
 
-    pd_temp[1023].fields.addr = phys_pd >> 12;
-    pd_temp[1023].fields.present = 1;
-    pd_temp[1023].fields.rw = 1;
+        uint32_t chunk = PAGES_PER_TABLE - pt_index;
+        if (chunk > pages_left)
+            chunk = pages_left;
 
-    // asm volatile("mov %0, %%cr3" ::"r"(phys_pd));
+        volatile pde_t *pde = get_pd_virt() + pd_index;
+        if (!pde->fields.present)
+            sync_kernel_pde(virt);
+        if (pde->fields.present && pde->fields.ps)
+        {
+            if (chunk == PAGES_PER_TABLE)
+            {
+                if (free_frames)
+                    free_contiguous_frames(pde->fields.addr << 12, PAGES_PER_TABLE);
+                removed_global |= pde->fields.global;
+                pde->raw_data = 0;
+                publish_kernel_pde(pd_index);
+            }
+            else if (!split_large_page(pd_index))
+                break;
+        }
 
-    unmap_page(TEMP_PD_VADDR);
+        if (pde->fields.present)
+        {
+            volatile pte_t *pt = get_pt_virt(pd_index);
+            for (uint32_t i = pt_index; i < pt_index + chunk; i++)
+            {
+                if (!pt[i].fields.present)
+                    continue;
 
-    return (volatile pde_t *)0xFFFFF000;
+                if (free_frames)
+                    put_pte_frame(*(pte_t *)&pt[i]);
+                removed_global |= pt[i].fields.global;
+                pt[i].raw_data = 0;
+
+                if (use_invlpg)
+                    invlpg((void *)((pd_index << 22) | (i << 12)));
+            }
+
+            // the frame of the table is not reused before the flush below.
+            // Kernel half tables are shared by every address space and are never freed
+            if (pd_index < KERNEL_PDE_START && page_table_empty(pd_index))
+            {
+                free_frame(pde->fields.addr << 12);
+                pde->raw_data = 0;
+                invlpg((void *)get_pt_virt(pd_index));
+            }
+        }
+
+        virt += chunk * PAGE_SIZE;
+        pages_left -= chunk;
+    }
+
+    if (use_invlpg)
+        return;
+
+    if (removed_global)
+        flush_tlb_global();
+    else
+        flush_tlb();
+}
+
+// maps frame at the copy window, returns its VIRTUAL address there
+static void *map_temp_frame(uint32_t phys)
+{
+    map_page(TEMP_COPY_VADDR, phys, PAGE_PRESENT | PAGE_RW);
+    return (void *)TEMP_COPY_VADDR;
+}
+
+static void unmap_temp_frame(void)
+{
+    unmap_page(TEMP_COPY_VADDR);
+}
+
+// allocates and zeroes the shared zero frame on first use
+static uint32_t get_zero_frame(void)
+{
+    if (!zero_frame)
+    {
+        uint32_t phys = alloc_zeroed_frame();
+        if (!phys)
+            return 0;
+        zero_frame = phys;
+    }
+    return zero_frame;
+}
+
+/* maps range read-only to the shared zero frame. First write to a page
+gives it a private zeroed frame, see break_cow. Returns false if out of frames */
+bool_t map_zero_range(uint32_t virt_start, uint32_t pages)
+{
+    uint32_t zero = get_zero_frame();
+    if (!zero)
+        return false;
+
+    for (uint32_t i = 0; i < pages; i++)
+    {
+        uint32_t virt = virt_start + i * PAGE_SIZE;
+        volatile pte_t *pte = ensure_pte(virt);
+        if (!pte)
+        {
+            flush_tlb_global();
+            return false;
+        }
+
+        pte->raw_data = make_pte(virt, zero, PAGE_PRESENT);
+        pte->fields.avl = PAGE_AVL_COW;
+    }
+
+    flush_tlb_global();
+    return true;
+}
+
+// copies content of mapped VIRTUAL page into given frame
+static void copy_page_to_frame(uint32_t virt, uint32_t phys)
+{
+    uint32_t eflags = irq_save(); // window is shared, see clear_frame
+    memcpy(map_temp_frame(phys), (const void *)virt, PAGE_SIZE);
+    unmap_temp_frame();
+    irq_restore(eflags);
+}
+
+/* maps dst range to the frames of src range, both read-only and copy-on-write.
+Pages not present in src stay unmapped in dst. Pages that can not be shared
+because the reference table is full are copied right away. Returns false if out of frames */
+bool_t clone_range(uint32_t dst_start, uint32_t src_start, uint32_t pages)
+{
+    bool_t ok = true;
+    for (uint32_t i = 0; i < pages; i++)
+    {
+        uint32_t src = src_start + i * PAGE_SIZE;
+        uint32_t dst = dst_start + i * PAGE_SIZE;
+
+        volatile pte_t *src_pte = find_pte(src, true);
+        if (!src_pte || !src_pte->fields.present)
+            continue;
+
+        volatile pte_t *dst_pte = ensure_pte(dst);
+        if (!dst_pte)
+        {
+            ok = false;
+            break;
+        }
+
+        uint32_t phys = src_pte->fields.addr << 12;
+        if (phys != zero_frame && !frame_ref_share(phys))
+        {
+            uint32_t copy = alloc_frame();
+            if (!copy)
+            {
+                ok = false;
+                break;
+            }
+            copy_page_to_frame(src, copy);
+            dst_pte->raw_data = make_pte(dst, copy, PAGE_PRESENT | PAGE_RW);
+            dst_pte->fields.dirty = 1; // content is not zero, calloc must not skip it
+            continue;
+        }
+
+        src_pte->fields.rw = 0;
+        src_pte->fields.avl |= PAGE_AVL_COW;
+        dst_pte->raw_data = make_pte(dst, phys, PAGE_PRESENT);
+        dst_pte->fields.avl = PAGE_AVL_COW;
+        dst_pte->fields.dirty = phys != zero_frame;
+    }
+
+    flush_tlb_global();
+    return ok;
+}
+
+bool_t is_page_cow(uint32_t virt)
+{
+    volatile pte_t *pte = find_pte(virt, false);
+    return pte && pte->fields.present && (pte->fields.avl & PAGE_AVL_COW);
+}
+
+/* resolves write to copy-on-write page. Last owner of a frame just gets it writable,
+otherwise the page is copied to a new frame (zero frame is never written).
+Sets `copied` if a frame was allocated. Returns false if page is not COW or out of frames */
+bool_t break_cow(uint32_t virt, bool_t *copied)
+{
+    virt &= ~(PAGE_SIZE - 1);
+    *copied = false;
+
+    volatile pte_t *pte = find_pte(virt, false);
+    if (!pte || !pte->fields.present || !(pte->fields.avl & PAGE_AVL_COW))
+        return false;
+
+    uint32_t phys = pte->fields.addr << 12;
+    if (phys != zero_frame && frame_ref_count(phys) == 1)
+    {
+        pte->fields.rw = 1;
+        pte->fields.avl &= ~PAGE_AVL_COW;
+        invlpg((void *)virt);
+        return true;
+    }
+
+    uint32_t copy = phys == zero_frame ? alloc_zeroed_frame() : alloc_frame();
+    if (!copy)
+        return false;
+
+    if (phys != zero_frame)
+    {
+        copy_page_to_frame(virt, copy);
+        frame_ref_put(phys);
+    }
+
+    pte->raw_data = make_pte(virt, copy, PAGE_PRESENT | PAGE_RW);
+    pte->fields.dirty = phys != zero_frame;
+    invlpg((void *)virt);
+    *copied = true;
+    return true;
+}
+
+// true if PAT is there, so PAGE_WC mappings are write-combining and not write-through
+bool_t pat_supported(void)
+{
+    uint32_t eax = 1, ebx, ecx, edx;
+    asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return (edx >> 16) & 1;
+}
+
+// returns true if given VIRTUAL page is mapped, by a PTE or a 4 MiB page
+bool_t is_page_mapped(uint32_t virt)
+{
+    volatile pde_t *pde = get_pde(virt);
+    if (pde->fields.present && pde->fields.ps)
+        return true;
+
+    volatile pte_t *pte = find_pte(virt, false);
+    return pte && pte->fields.present;
+}
+
+// returns true if given VIRTUAL page is present and was written since it was mapped
+bool_t get_page_dirty_flag(uint32_t virt)
+{
+    volatile pde_t *pde = get_pde(virt);
+    if (pde->fields.present && pde->fields.ps)
+        return pde->fields.dirty || (pde->fields.avl & PAGE_AVL_SOFT_DIRTY);
+
+    volatile pte_t *pte = find_pte(virt, false);
+    return pte && pte->fields.present && (pte->fields.dirty || (pte->fields.avl & PAGE_AVL_SOFT_DIRTY));
+}
+
+/* samples and clears accessed and dirty flags of given VIRTUAL page, for a 4 MiB page those of the
+whole large page. The dirty flag moves to PAGE_AVL_SOFT_DIRTY, so get_page_dirty_flag still
+reports the page until it is remapped. Returns PAGE_SCAN_* bits */
+uint32_t scan_page_access(uint32_t virt)
+{
+    virt &= ~(PAGE_SIZE - 1);
+
+    volatile pde_t *pde = get_pde(virt);
+    if (!pde->fields.present)
+        return PAGE_SCAN_NO_TABLE;
+
+    pte_t entry;
+    volatile uint32_t *raw;
+    if (pde->fields.ps)
+        raw = &pde->raw_data;
+    else
+        raw = &get_pte(virt)->raw_data;
+
+    // accessed, dirty and avl sit at the same bits in a PTE and a 4 MiB PDE
+    entry.raw_data = *raw;
+    if (!entry.fields.present)
+        return 0;
+
+    uint32_t bits = PAGE_SCAN_PRESENT;
+    if (entry.fields.accessed)
+        bits |= PAGE_SCAN_ACCESSED;
+    if (entry.fields.dirty)
+    {
+        bits |= PAGE_SCAN_DIRTY;
+        entry.fields.avl |= PAGE_AVL_SOFT_DIRTY;
+    }
+
+    if (bits & (PAGE_SCAN_ACCESSED | PAGE_SCAN_DIRTY))
+    {
+        entry.fields.accessed = 0;
+        entry.fields.dirty = 0;
+        *raw = entry.raw_data;
+        invlpg((void *)virt); // cached translation would not set the flags again
+    }
+    return bits;
 }
 
 static inline void move_stack_to_high_half(void)
@@ -357,19 +1014,170 @@ static inline void init_kernel_gdt(void)
         : "memory", "ax");
 }
 
+// copies map left by boot.asm, low memory is still identity mapped by the bootstrap PD
+static void load_memory_map(void)
+{
+    const e820_map_t *map = (const e820_map_t *)E820_MAP_PHYS;
+    uint32_t count = map->count < E820_MAX_ENTRIES ? map->count : E820_MAX_ENTRIES;
+
+    memory_map_count = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const e820_entry_t *entry = &map->entries[i];
+        if (!entry->length || !(entry->acpi & E820_ACPI_VALID))
+            continue;
+        memory_map[memory_map_count++] = *entry;
+    }
+}
+
+// clips E820 entry to 4 GiB and converts it to frames, rounding inwards or outwards
+static void e820_entry_frames(const e820_entry_t *entry, bool_t inwards, uint32_t *start, uint32_t *end)
+{
+    const uint64_t limit = (uint64_t)TOTAL_FRAMES * PAGE_SIZE;
+    uint64_t base = entry->base < limit ? entry->base : limit;
+    uint64_t top = entry->base + entry->length < limit ? entry->base + entry->length : limit;
+
+    if (inwards)
+    {
+        *start = (base + PAGE_SIZE - 1) >> 12;
+        *end = top >> 12;
+    }
+    else
+    {
+        *start = base >> 12;
+        *end = (top + PAGE_SIZE - 1) >> 12;
+    }
+}
+
+/* picks frames for the buddy bitmaps: usable RAM from `first` on inside the 4 MiB
+high-half kernel window, the only RAM mapped this early. Returns first frame or 0 */
+static uint32_t place_buddy_storage(uint32_t first, uint32_t pages)
+{
+    uint32_t window_end = (KERNEL_PHYS_BASE + LARGE_PAGE_SIZE) / PAGE_SIZE;
+    uint32_t start, end;
+
+    if (!memory_map_count)
+        return first + pages <= window_end ? first : 0;
+
+    for (uint32_t i = 0; i < memory_map_count; i++)
+    {
+        if (memory_map[i].type != E820_TYPE_USABLE)
+            continue;
+        e820_entry_frames(&memory_map[i], true, &start, &end);
+        if (start < first)
+            start = first;
+        if (end > window_end)
+            end = window_end;
+        if (start < end && end - start >= pages)
+            return start;
+    }
+    return 0;
+}
+
+/* Sizes the frame allocator to the end of usable RAM, frees usable ranges
+and takes back everything else the BIOS reported, the kernel and the buddy bitmaps */
+static void seed_frame_allocator(void)
+{
+    // everything below the end of the kernel image and the high-half stack stays reserved,
+    // this covers the bootstrap and low memory
+    uint32_t reserved_frames = (KERNEL_PHYS_END + HIGH_HALF_STACK_CAPACITY + PAGE_SIZE - 1) / PAGE_SIZE;
+    // frames of the VGA memory, option ROMs and the BIOS, never RAM even without E820 map
+    uint32_t low_hole_first = 0xA0000 / PAGE_SIZE;
+    uint32_t low_hole_end = 0x100000 / PAGE_SIZE;
+    // bitmaps are sized by RAM, so they go past the reserved frames and the hole below 1 MiB
+    uint32_t storage_first = reserved_frames > low_hole_end ? reserved_frames : low_hole_end;
+    uint32_t start, end;
+
+    frame_count = 0;
+    for (uint32_t i = 0; i < memory_map_count; i++)
+    {
+        if (memory_map[i].type != E820_TYPE_USABLE)
+            continue;
+        e820_entry_frames(&memory_map[i], true, &start, &end);
+        if (end > frame_count)
+            frame_count = end;
+    }
+
+    if (!memory_map_count)
+    {
+        serial_write_str("E820 memory map is empty, assuming all frames exist\n");
+        frame_count = TOTAL_FRAMES;
+    }
+
+    uint32_t storage_pages = (BUDDY_STORAGE_WORDS(frame_count) * sizeof(uint32_t) + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t storage_frame = place_buddy_storage(storage_first, storage_pages);
+    if (!storage_frame)
+    {
+        serial_write_str("no usable RAM for frame allocator bitmaps\n");
+        frame_count = 0;
+        buddy_init(0, NULL);
+        return;
+    }
+
+    buddy_init(frame_count, phys_to_vir_addr(storage_frame * PAGE_SIZE));
+
+    if (!memory_map_count)
+        buddy_free_range(reserved_frames, frame_count - reserved_frames);
+
+    for (uint32_t i = 0; i < memory_map_count; i++)
+    {
+        if (memory_map[i].type != E820_TYPE_USABLE)
+            continue;
+        e820_entry_frames(&memory_map[i], true, &start, &end);
+        if (end > start)
+            buddy_free_range(start, end - start);
+    }
+
+    // BIOS ranges may overlap usable ones
+    for (uint32_t i = 0; i < memory_map_count; i++)
+    {
+        if (memory_map[i].type == E820_TYPE_USABLE)
+            continue;
+        e820_entry_frames(&memory_map[i], false, &start, &end);
+        if (end > start)
+            buddy_reserve_range(start, end - start);
+    }
+
+    buddy_reserve_range(0, reserved_frames);
+    buddy_reserve_range(low_hole_first, low_hole_end - low_hole_first);
+    buddy_reserve_range(storage_frame, storage_pages);
+
+    serial_write_str("usable RAM frames: ");
+    serial_write_uint32(buddy_free_frames());
+    serial_write_str(" of ");
+    serial_write_uint32(frame_count);
+    serial_write_str("\n");
+}
+
+// frames that can still be allocated, cached and pre-zeroed ones included
+uint32_t get_free_frame_count(void)
+{
+    return buddy_free_frames() + frame_cache_count + zero_pool_count;
+}
+
+// number of frames the allocator covers
+uint32_t get_frame_count(void)
+{
+    return frame_count;
+}
+
+// memory map reported by BIOS, entries with zero length or ACPI ignore attribute are dropped
+const e820_entry_t *get_memory_map(uint32_t *count)
+{
+    *count = memory_map_count;
+    return memory_map;
+}
+
 void setup_high_half_selfcontained_paging(void)
 {
     asm volatile("cli");
     move_stack_to_high_half();
     init_kernel_gdt();
 
-    for (uint32_t i = 0; i < KERNEL_PHYS_END / PAGE_SIZE; i++)
-        set_alv_frame(i, true);
+    load_memory_map();
+    seed_frame_allocator();
 
-    for (int i = 0xA0000; i <= 0xBFFFF; i++)
-        set_alv_frame(i / PAGE_SIZE, true);
-
-    uint32_t kernel_pd_phys = alloc_page_directory_phys();
+    kernel_pd_phys = alloc_page_directory_phys();
     if (!kernel_pd_phys)
         return;
 
@@ -389,5 +1197,8 @@ void setup_high_half_selfcontained_paging(void)
 
     unmap_page(TEMP_PD_VADDR);
 
-    load_page_directory_extern((pde_t *)kernel_pd_phys);
+    load_page_directory_phys(kernel_pd_phys);
+
+    map_page(KERNEL_PD_VADDR, kernel_pd_phys, PAGE_PRESENT | PAGE_RW);
+    kernel_page_directory = (pde_t *)KERNEL_PD_VADDR;
 }
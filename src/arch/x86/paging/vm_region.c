@@ -0,0 +1,148 @@
+#include <paging/vm_region.h>
+#include <paging/paging.h>
+#include <lib/mem.h>
+
+#include <drivers/qemu_serial.h>
+
+// sorted by start address
+static vm_region_t regions[VM_REGION_MAX];
+static uint32_t region_count = 0;
+
+vm_region_t *vm_region_register(const char *name, uint32_t start, uint32_t end, uint32_t flags, vm_fault_hook_t on_fault)
+{
+    if (region_count == VM_REGION_MAX || start >= end)
+        return NULL;
+
+    uint32_t pos = 0;
+    while (pos < region_count && regions[pos].start < start)
+        pos++;
+
+    if ((pos > 0 && regions[pos - 1].end > start) || (pos < region_count && regions[pos].start < end))
+        return NULL;
+
+    memmove(&regions[pos + 1], &regions[pos], (region_count - pos) * sizeof(vm_region_t));
+    region_count++;
+
+    vm_region_t *region = &regions[pos];
+    region->name = name;
+    region->start = start;
+    region->end = end;
+    region->flags = flags;
+    region->minor_faults = 0;
+    region->major_faults = 0;
+    region->on_fault = on_fault;
+    return region;
+}
+
+void vm_region_unregister(vm_region_t *region)
+{
+    uint32_t pos = region - regions;
+    if (pos >= region_count)
+        return;
+
+    region_count--;
+    memmove(&regions[pos], &regions[pos + 1], (region_count - pos) * sizeof(vm_region_t));
+}
+
+vm_region_t *vm_region_find(uint32_t addr)
+{
+    uint32_t lo = 0;
+    uint32_t hi = region_count;
+    while (lo < hi)
+    {
+        uint32_t mid = (lo + hi) / 2;
+        if (addr < regions[mid].start)
+            hi = mid;
+        else if (addr >= regions[mid].end)
+            lo = mid + 1;
+        else
+            return &regions[mid];
+    }
+    return NULL;
+}
+
+uint32_t vm_region_count(void)
+{
+    return region_count;
+}
+
+vm_region_t *vm_region_get(uint32_t index)
+{
+    return index < region_count ? &regions[index] : NULL;
+}
+
+void vm_region_print_stats(void)
+{
+    for (uint32_t i = 0; i < region_count; i++)
+    {
+        serial_write_str("\nREGION ");
+        serial_write_str(regions[i].name);
+        serial_write_str(" ");
+        serial_write_hex_uint32(regions[i].start);
+        serial_write_str("-");
+        serial_write_hex_uint32(regions[i].end);
+        serial_write_str(" MINOR: ");
+        serial_write_uint32(regions[i].minor_faults);
+        serial_write_str(" MAJOR: ");
+        serial_write_uint32(regions[i].major_faults);
+    }
+    serial_write_str("\n");
+}
+
+bool_t handle_page_fault(uint32_t fault_addr, uint32_t err_code)
+{
+    vm_region_t *region = vm_region_find(fault_addr);
+
+    // kernel PDE added after the current address space was created
+    if (!(err_code & PF_PRESENT) && sync_kernel_pde(fault_addr))
+    {
+        if (region)
+            region->minor_faults++;
+        return true;
+    }
+
+    // write to copy-on-write page, valid wherever it was mapped
+    if ((err_code & PF_PRESENT) && (err_code & PF_WRITE) && is_page_cow(fault_addr))
+    {
+        bool_t copied;
+        if (!break_cow(fault_addr, &copied))
+            return false;
+
+        if (region && copied)
+            region->major_faults++;
+        else if (region)
+            region->minor_faults++;
+        return true;
+    }
+
+    if (!region)
+        return false;
+
+    if ((err_code & PF_WRITE) && !(region->flags & VM_REGION_WRITABLE))
+        return false;
+
+    uint32_t page = fault_addr & ~(PAGE_SIZE - 1);
+
+    // mapped meanwhile, only the TLB entry was stale
+    if (!(err_code & PF_PRESENT) && is_page_mapped(page))
+    {
+        asm volatile("invlpg (%0)" ::"r"(page) : "memory");
+        region->minor_faults++;
+        return true;
+    }
+
+    if ((err_code & PF_PRESENT) || !(region->flags & VM_REGION_DEMAND_ZERO))
+        return false;
+
+    uint32_t frame = alloc_zeroed_frame();
+    if (!frame)
+        return false;
+
+    map_page(page, frame, PAGE_PRESENT | PAGE_RW); // new PTE is clean, dirty means written since zero fill
+
+    region->major_faults++;
+    if (region->on_fault)
+        region->on_fault(region, page);
+
+    return true;
+}
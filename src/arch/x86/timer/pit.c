@@ -3,6 +3,7 @@
 #include <ports.h>
 #include <interrupts/isr.h>
 #include <interrupts/pic.h>
+#include <cpu.h>
 
 static volatile uint64_t timer_ticks = 0;
 
@@ -63,5 +64,5 @@ void sleep(uint32_t ms)
 {
     uint64_t target = get_timer_ticks() + ms;
     while (get_timer_ticks() < target)
-        asm volatile("hlt");
+        cpu_idle();
 }
@@ -0,0 +1,89 @@
+#include <kernel/arena.h>
+#include <kernel/memory.h>
+#include <paging/paging.h>
+
+#define CHUNK_HEADER_SIZE ((sizeof(arena_chunk_t) + 7) & ~7)
+
+void arena_init(arena_t *arena)
+{
+    arena->head = NULL;
+    arena->current = NULL;
+}
+
+// allocates page aligned chunk that can hold at least n bytes and links it after current
+static arena_chunk_t *arena_grow(arena_t *arena, uint32_t n)
+{
+    uint32_t size = n + CHUNK_HEADER_SIZE;
+    if (size < ARENA_CHUNK_SIZE)
+        size = ARENA_CHUNK_SIZE;
+    size = (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    arena_chunk_t *chunk = kmalloc_aligned(size, PAGE_SIZE);
+    if (!chunk)
+        return NULL;
+
+    chunk->size = size - CHUNK_HEADER_SIZE;
+    chunk->used = 0;
+
+    if (arena->current)
+    {
+        chunk->next = arena->current->next;
+        arena->current->next = chunk;
+    }
+    else
+    {
+        chunk->next = arena->head;
+        arena->head = chunk;
+    }
+    arena->current = chunk;
+
+    return chunk;
+}
+
+// returns 8 byte aligned memory that lives until the arena is reset or destroyed
+void *arena_alloc(arena_t *arena, uint32_t n)
+{
+    // no chunk can be bigger than the heap, larger n would also wrap when rounded up
+    if (n == 0 || n > HEAP_END - SLAB_END)
+        return NULL;
+
+    n = (n + 7) & ~7;
+
+    arena_chunk_t *chunk = arena->current;
+
+    // chunks kept by arena_reset are reused first
+    while (chunk && chunk->size - chunk->used < n)
+    {
+        chunk = chunk->next;
+        if (chunk)
+            arena->current = chunk;
+    }
+
+    if (!chunk && !(chunk = arena_grow(arena, n)))
+        return NULL;
+
+    void *ptr = (uint8_t *)chunk + CHUNK_HEADER_SIZE + chunk->used;
+    chunk->used += n;
+    return ptr;
+}
+
+// drops every allocation but keeps the chunks for reuse
+void arena_reset(arena_t *arena)
+{
+    for (arena_chunk_t *chunk = arena->head; chunk; chunk = chunk->next)
+        chunk->used = 0;
+    arena->current = arena->head;
+}
+
+// gives every chunk back to the heap
+void arena_destroy(arena_t *arena)
+{
+    arena_chunk_t *chunk = arena->head;
+    while (chunk)
+    {
+        arena_chunk_t *next = chunk->next;
+        kfree_aligned(chunk);
+        chunk = next;
+    }
+    arena_init(arena);
+}
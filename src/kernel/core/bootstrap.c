@@ -5,5 +5,7 @@ __attribute__((section(".bootstrap"))) void bootstrap_main(void)
     asm volatile("cli");
     bootstrap_setup_mapping();
     bootstrap_enable_global_pages();
+    bootstrap_enable_large_pages();
+    bootstrap_setup_pat();
     bootstrap_enable_paging();
 }
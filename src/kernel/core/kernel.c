@@ -10,6 +10,8 @@
 #include <kernel/diagnostics/warning_routine.h>
 #include <kernel/settings.h>
 #include <kernel/memory.h>
+#include <kernel/vmalloc.h>
+#include <kernel/working_set.h>
 #include "../../apps/app_selector/app_selector.h"
 
 void kernel_main()
@@ -42,6 +44,14 @@ void kernel_main()
     heap_init();
     print(done_text);
 
+    print("vmalloc Initialization... ");
+    vmalloc_init();
+    print(done_text);
+
+    print("Starting working set scanner... ");
+    working_set_init();
+    print(done_text);
+
     print("Installing mouse... ");
     mouse_install();
     print(done_text);
@@ -60,8 +70,15 @@ void kernel_main()
 
     print("Testing VGA modes... ");
     set_graphics_mode();
+#ifdef VGA_BENCH
+    vga_cache_benchmark_13h();
+#endif
     draw_mode13h_test_pattern();
     set_text_mode();
+#ifdef VGA_BENCH
+    vga_cache_benchmark_text();
+    clear_screen();
+#endif
     print(done_text);
 
     clear_screen();
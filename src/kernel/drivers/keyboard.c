@@ -5,6 +5,7 @@
 #include <lib/types.h>
 #include <drivers/screen.h>
 #include <lib/math.h>
+#include <cpu.h>
 
 #define KBD_DATA_PORT 0x60
 
@@ -110,7 +111,7 @@ int read_number_conf(uint8_t number_to_read_len, bool_t overflow_catch)
     {
         char c = 0;
         while (!(c = get_keyboard_char()))
-            asm volatile("hlt");
+            cpu_idle();
 
         if (c == '\n' || c == '\r')
         {
@@ -182,7 +183,7 @@ uint32_t read_hex(void)
     {
         char c = 0;
         while (!(c = get_keyboard_char()))
-            asm volatile("hlt");
+            cpu_idle();
 
         if (c == '\n' || c == '\r')
         {
@@ -34,6 +34,13 @@ void serial_write_str(const char *s)
         serial_write_char(*s++);
 }
 
+void serial_write_bytes(const void *data, uint32_t length)
+{
+    const uint8_t *bytes = data;
+    while (length--)
+        serial_write_char(*bytes++);
+}
+
 void serial_write_hex_uint8(unsigned char byte)
 {
     const char hex_digits[] = "0123456789ABCDEF";
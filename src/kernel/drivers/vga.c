@@ -13,6 +13,11 @@
 #include <lib/mem.h>
 #include <lib/types.h>
 
+#ifdef VGA_BENCH
+#include <paging/paging.h>
+#include <drivers/qemu_serial.h>
+#endif
+
 #define VGA_AC_INDEX 0x3C0
 #define VGA_AC_WRITE 0x3C0
 #define VGA_AC_READ 0x3C1
@@ -1012,6 +1017,67 @@ void draw_mode13h_test_pattern(void)
             vga[y * 320 + x] = (uint8_t)((x + y) & 0xFF);
 }
 
+#ifdef VGA_BENCH
+
+#define VGA_VRAM_PHYS 0xA0000
+#define VGA_VRAM_PAGES 32 // 0xA0000 - 0xBFFFF
+#define VGA_BENCH_ROUNDS 64
+
+static inline uint64_t rdtsc(void)
+{
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// fills window `rounds` times with 32-bit stores, returns TSC cycles per KiB
+static uint32_t vga_fill_cycles_per_kib(uint32_t virt, uint32_t bytes, uint32_t rounds)
+{
+    volatile uint32_t *dst = (volatile uint32_t *)virt;
+    uint64_t start = rdtsc();
+    for (uint32_t r = 0; r < rounds; r++)
+        for (uint32_t i = 0; i < bytes / 4; i++)
+            dst[i] = r * 0x01010101;
+
+    // in units of 16 cycles, so the 32-bit division has headroom without libgcc
+    uint32_t cycles = (uint32_t)((rdtsc() - start) >> 4);
+    uint32_t kib = bytes * rounds / 1024;
+    return cycles / kib * 16;
+}
+
+static void vga_bench_window(const char *name, uint32_t virt, uint32_t bytes)
+{
+    map_range(VGA_13h_START, VGA_VRAM_PHYS, VGA_VRAM_PAGES, PAGE_PRESENT | PAGE_RW | PAGE_UC);
+    uint32_t uc = vga_fill_cycles_per_kib(virt, bytes, VGA_BENCH_ROUNDS);
+
+    map_range(VGA_13h_START, VGA_VRAM_PHYS, VGA_VRAM_PAGES, PAGE_PRESENT | PAGE_RW | PAGE_WC);
+    uint32_t wc = vga_fill_cycles_per_kib(virt, bytes, VGA_BENCH_ROUNDS);
+
+    serial_write_str("VGA FILL ");
+    serial_write_str(name);
+    serial_write_str(" UC: ");
+    serial_write_uint32(uc);
+    serial_write_str(" WC: ");
+    serial_write_uint32(wc);
+    serial_write_str(" cycles/KiB\n");
+}
+
+/* compares fill bandwidth of uncached and write-combining VGA mappings, results go to serial.
+Mode 13h part must run in graphics mode, text part in text mode. VRAM is left WC */
+void vga_cache_benchmark_13h(void)
+{
+    if (!pat_supported())
+        serial_write_str("VGA FILL: no PAT, WC mapping is write-through\n");
+    vga_bench_window("13h", VGA_13h_START, 320 * 200);
+}
+
+void vga_cache_benchmark_text(void)
+{
+    vga_bench_window("03h", VGA_03h_START, 80 * 25 * 2);
+}
+
+#endif
+
 void set_text_mode(void)
 {
     uint8_t rows, cols, ht;
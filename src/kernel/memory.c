@@ -1,118 +1,737 @@
 #include <kernel/memory.h>
 #include <paging/paging.h>
+#include <paging/vm_region.h>
+#include <lib/mem.h>
 
 #include <drivers/qemu_serial.h>
 
-static block_t *heap_free_list = NULL;
+#ifdef HEAP_TRACE
+#include <timer/pit.h>
+#endif
 
-// resets the heap. Call this before first malloc
-void heap_init(void)
+#define SLAB_OBJS_OFFSET ((sizeof(slab_t) + 7) & ~7)
+
+#define BLOCK_MIN_SIZE ((sizeof(block_t) + BLOCK_TAG_SIZE + 7) & ~7)
+#define BIN_SL_BITS 2 // each power of two range is split into 4 bins
+#define BIN_SL_COUNT (1 << BIN_SL_BITS)
+#define BIN_FL_COUNT 32
+
+#define HEAP_TRIM_THRESHOLD (16 * PAGE_SIZE) // min tail size given back to the frame allocator
+
+#ifdef HEAP_TRACE
+#define HEAP_TRACE_RECORD(op, size, ptr) heap_trace_record(op, (uint32_t)__builtin_return_address(0), size, (uint32_t)(ptr))
+#else
+#define HEAP_TRACE_RECORD(op, size, ptr) \
+    do                                   \
+    {                                    \
+    } while (0)
+#endif
+
+typedef struct
 {
-    uint32_t phys = alloc_contiguous_frames((HEAP_END - HEAP_START) / PAGE_SIZE);
-    if (!phys)
+    slab_t *partial; // slabs with at least one free object
+    uint32_t slabs;
+    uint32_t objects_in_use;
+} slab_class_t;
+
+static block_t *heap_bins[BIN_FL_COUNT][BIN_SL_COUNT];
+static uint32_t heap_fl_bitmap = 0;
+static uint32_t heap_sl_bitmap[BIN_FL_COUNT];
+static uint32_t heap_free_bytes = 0;  // bytes in binned free blocks
+static uint32_t heap_free_blocks = 0;
+static uint32_t slab_bytes_in_use = 0; // object sizes of live slab allocations
+static uint32_t heap_peak_bytes = 0;
+static uint32_t heap_alloc_count = 0;
+static uint32_t heap_free_count = 0;
+static uint32_t heap_mapped_top = SLAB_END; // end of the highest demand-mapped page below the epilogue page
+
+#ifdef HEAP_TRACE
+static heap_trace_record_t heap_trace_ring[HEAP_TRACE_RING_SIZE];
+static volatile uint32_t heap_trace_head = 0; // next slot to write, only ever grows
+static uint32_t heap_trace_tail = 0;          // next slot to drain
+
+/* reserving the slot is a single atomic add, so records
+from interrupt handlers never share a slot with interrupted code */
+static void heap_trace_record(uint8_t op, uint32_t caller, uint32_t size, uint32_t ptr)
+{
+    uint32_t slot = __atomic_fetch_add(&heap_trace_head, 1, __ATOMIC_RELAXED) & (HEAP_TRACE_RING_SIZE - 1);
+    heap_trace_record_t *rec = &heap_trace_ring[slot];
+    rec->timestamp = (uint32_t)get_timer_ticks();
+    rec->caller = caller;
+    rec->size = size;
+    rec->ptr = ptr;
+    rec->op = op;
+}
+
+/* sends records collected since last drain to serial as one frame:
+"HTRC", u32 count, u32 dropped, count * packed heap_trace_record_t (little endian) */
+void heap_trace_drain(void)
+{
+    uint32_t head = heap_trace_head;
+    uint32_t dropped = 0;
+    if (head - heap_trace_tail > HEAP_TRACE_RING_SIZE)
+    {
+        dropped = head - heap_trace_tail - HEAP_TRACE_RING_SIZE;
+        heap_trace_tail = head - HEAP_TRACE_RING_SIZE;
+    }
+    uint32_t count = head - heap_trace_tail;
+
+    serial_write_bytes("HTRC", 4);
+    serial_write_bytes(&count, sizeof(count));
+    serial_write_bytes(&dropped, sizeof(dropped));
+    for (; heap_trace_tail != head; heap_trace_tail++)
+        serial_write_bytes(&heap_trace_ring[heap_trace_tail & (HEAP_TRACE_RING_SIZE - 1)], sizeof(heap_trace_record_t));
+}
+#endif
+
+static slab_class_t slab_classes[SLAB_CLASS_COUNT];
+static uint8_t *slab_brk = (uint8_t *)SLAB_START;
+static slab_t *free_slabs = NULL; // empty slabs returned by classes
+
+// returns size class index for n in 1..SLAB_MAX_OBJ_SIZE
+static inline uint32_t slab_class_of(uint32_t n)
+{
+    if (n <= SLAB_MIN_OBJ_SIZE)
         return 0;
-    map_range(HEAP_START, phys, (HEAP_END - HEAP_START) / PAGE_SIZE, PAGE_RW | PAGE_PRESENT);
+    return (32 - __builtin_clz(n - 1)) - 3;
+}
+
+static inline void slab_unlink(slab_class_t *cls, slab_t *s)
+{
+    if (s->prev)
+        s->prev->next = s->next;
+    else
+        cls->partial = s->next;
+    if (s->next)
+        s->next->prev = s->prev;
+    s->next = s->prev = NULL;
+}
 
-    heap_free_list = (block_t *)HEAP_START;
-    heap_free_list->size = HEAP_END - HEAP_START - sizeof(block_t);
-    heap_free_list->next = NULL;
+static inline void slab_push(slab_class_t *cls, slab_t *s)
+{
+    s->prev = NULL;
+    s->next = cls->partial;
+    if (cls->partial)
+        cls->partial->prev = s;
+    cls->partial = s;
 }
 
-void *malloc(uint32_t n)
+// takes SLAB_SIZE bytes from the slab window and formats them for class ci
+static slab_t *slab_create(uint32_t ci)
 {
-    if (n == 0)
+    slab_t *s;
+    if (free_slabs)
+    {
+        s = free_slabs;
+        free_slabs = s->next;
+    }
+    else
+    {
+        if ((uint32_t)slab_brk >= SLAB_END)
+            return NULL;
+        s = (slab_t *)slab_brk;
+        slab_brk += SLAB_SIZE;
+    }
+
+    s->obj_size = SLAB_MIN_OBJ_SIZE << ci;
+    s->capacity = (SLAB_SIZE - SLAB_OBJS_OFFSET) / s->obj_size;
+    s->in_use = 0;
+    s->class_index = ci;
+    s->free_list = NULL;
+    s->unused = (uint8_t *)s + SLAB_OBJS_OFFSET;
+
+    slab_classes[ci].slabs++;
+    slab_push(&slab_classes[ci], s);
+    return s;
+}
+
+static void *slab_alloc(uint32_t ci)
+{
+    slab_class_t *cls = &slab_classes[ci];
+    slab_t *s = cls->partial;
+    if (!s && !(s = slab_create(ci)))
         return NULL;
 
-    n = (n + 7) & ~7;
+    void *obj;
+    if (s->free_list)
+    {
+        obj = s->free_list;
+        s->free_list = *(void **)obj;
+    }
+    else
+    {
+        obj = s->unused;
+        s->unused += s->obj_size;
+    }
+
+    if (++s->in_use == s->capacity)
+        slab_unlink(cls, s);
+    cls->objects_in_use++;
+    slab_bytes_in_use += s->obj_size;
 
-    block_t *best = NULL;
-    block_t *best_prev = NULL;
+    return obj;
+}
+
+static void slab_free(void *ptr)
+{
+    slab_t *s = (slab_t *)((uint32_t)ptr & ~(SLAB_SIZE - 1));
+    slab_class_t *cls = &slab_classes[s->class_index];
+
+    if ((uint8_t *)ptr < (uint8_t *)s + SLAB_OBJS_OFFSET)
+        return;
+
+    *(void **)ptr = s->free_list;
+    s->free_list = ptr;
+    cls->objects_in_use--;
+    slab_bytes_in_use -= s->obj_size;
+
+    if (s->in_use-- == s->capacity)
+        slab_push(cls, s);
 
-    for (block_t *curr = heap_free_list, *prev = NULL; curr != NULL; prev = curr, curr = curr->next)
+    // keep one empty slab per class to avoid thrashing on alloc/free pairs
+    if (s->in_use == 0 && (s->next || s->prev))
     {
-        if (curr->size >= n)
-        {
-            if (best == NULL || curr->size < best->size)
-            {
-                best = curr;
-                best_prev = prev;
-                if (curr->size == n)
-                    break;
-            }
-        }
+        slab_unlink(cls, s);
+        cls->slabs--;
+        s->next = free_slabs;
+        free_slabs = s;
+    }
+}
+
+static inline uint32_t block_size(const block_t *blk) { return blk->size & ~7; }
+static inline bool_t block_used(const block_t *blk) { return blk->size & BLOCK_USED; }
+static inline block_t *block_next(block_t *blk) { return (block_t *)((uint8_t *)blk + block_size(blk)); }
+static inline uint32_t *block_footer(block_t *blk) { return (uint32_t *)((uint8_t *)blk + block_size(blk) - BLOCK_TAG_SIZE); }
+
+static inline void block_set(block_t *blk, uint32_t size, bool_t used)
+{
+    blk->size = size | (used ? BLOCK_USED : 0);
+    *block_footer(blk) = blk->size;
+}
+
+// splits size into first level (power of two) and second level (linear subdivision) bin indices
+static inline void bin_mapping(uint32_t size, uint32_t *fl, uint32_t *sl)
+{
+    *fl = 31 - __builtin_clz(size);
+    *sl = (size >> (*fl - BIN_SL_BITS)) & (BIN_SL_COUNT - 1);
+}
+
+static inline void bin_insert(block_t *blk)
+{
+    uint32_t fl, sl;
+    bin_mapping(block_size(blk), &fl, &sl);
+
+    blk->prev = NULL;
+    blk->next = heap_bins[fl][sl];
+    if (blk->next)
+        blk->next->prev = blk;
+    heap_bins[fl][sl] = blk;
+
+    heap_fl_bitmap |= 1u << fl;
+    heap_sl_bitmap[fl] |= 1u << sl;
+
+    heap_free_bytes += block_size(blk);
+    heap_free_blocks++;
+}
+
+static inline void bin_remove(block_t *blk)
+{
+    uint32_t fl, sl;
+    bin_mapping(block_size(blk), &fl, &sl);
+
+    if (blk->prev)
+        blk->prev->next = blk->next;
+    else
+        heap_bins[fl][sl] = blk->next;
+    if (blk->next)
+        blk->next->prev = blk->prev;
+
+    heap_free_bytes -= block_size(blk);
+    heap_free_blocks--;
+
+    if (!heap_bins[fl][sl])
+    {
+        heap_sl_bitmap[fl] &= ~(1u << sl);
+        if (!heap_sl_bitmap[fl])
+            heap_fl_bitmap &= ~(1u << fl);
     }
+}
+
+// returns free block of at least size bytes from the first non-empty suitable bin, or NULL
+static block_t *bin_find(uint32_t size)
+{
+    uint32_t fl, sl;
 
-    if (best == NULL)
+    // round up to the next bin so any block found there fits
+    size += (1u << ((31 - __builtin_clz(size)) - BIN_SL_BITS)) - 1;
+    bin_mapping(size, &fl, &sl);
+    if (fl >= BIN_FL_COUNT)
         return NULL;
 
-    if (best->size >= n + sizeof(block_t) + 8)
+    uint32_t sl_map = heap_sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map)
     {
-        uint8_t *base = (uint8_t *)best;
-        block_t *new_block = (block_t *)(base + sizeof(block_t) + n);
+        uint32_t fl_map = fl + 1 < BIN_FL_COUNT ? heap_fl_bitmap & (~0u << (fl + 1)) : 0;
+        if (!fl_map)
+            return NULL;
+        fl = __builtin_ctz(fl_map);
+        sl_map = heap_sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
 
-        new_block->size = best->size - n - sizeof(block_t);
-        new_block->next = best->next;
+    return heap_bins[fl][sl];
+}
 
-        best->next = new_block;
-        best->size = n;
+// demand-zero fault hook of the large block heap, keeps track of the highest mapped page
+static void heap_on_fault(vm_region_t *region, uint32_t page)
+{
+    (void)region;
+    if (page < HEAP_END - PAGE_SIZE && page + PAGE_SIZE > heap_mapped_top)
+        heap_mapped_top = page + PAGE_SIZE;
+}
+
+/* resets the heap. Call this before first malloc.
+Nothing is mapped here: the window is only reserved virtually
+and pages are backed one by one from the page fault handler */
+void heap_init(void)
+{
+    // the whole window is backed lazily by zeroed frames on first touch
+    vm_region_register("slab", SLAB_START, SLAB_END, VM_REGION_WRITABLE | VM_REGION_DEMAND_ZERO, NULL);
+    vm_region_register("heap", SLAB_END, HEAP_END, VM_REGION_WRITABLE | VM_REGION_DEMAND_ZERO, heap_on_fault);
+
+    for (uint32_t i = 0; i < SLAB_CLASS_COUNT; i++)
+    {
+        slab_classes[i].partial = NULL;
+        slab_classes[i].slabs = 0;
+        slab_classes[i].objects_in_use = 0;
     }
+    slab_brk = (uint8_t *)SLAB_START;
+    free_slabs = NULL;
 
-    if (best_prev == NULL)
-        heap_free_list = best->next;
-    else
-        best_prev->next = best->next;
+    for (uint32_t i = 0; i < BIN_FL_COUNT; i++)
+    {
+        heap_sl_bitmap[i] = 0;
+        for (uint32_t j = 0; j < BIN_SL_COUNT; j++)
+            heap_bins[i][j] = NULL;
+    }
+    heap_fl_bitmap = 0;
+    heap_mapped_top = SLAB_END;
+
+    heap_free_bytes = 0;
+    heap_free_blocks = 0;
+    slab_bytes_in_use = 0;
+    heap_peak_bytes = 0;
+    heap_alloc_count = 0;
+    heap_free_count = 0;
+
+    // used prologue and epilogue tags keep coalescing inside the heap
+    *(uint32_t *)SLAB_END = BLOCK_USED;
+    *(uint32_t *)(HEAP_END - BLOCK_TAG_SIZE) = BLOCK_USED;
 
-    return (uint8_t *)best + sizeof(block_t);
+    block_t *blk = (block_t *)(SLAB_END + BLOCK_TAG_SIZE);
+    block_set(blk, HEAP_END - SLAB_END - 2 * BLOCK_TAG_SIZE, false);
+    bin_insert(blk);
 }
 
-void free(void *ptr)
+// gives pages of the free top block back to the frame allocator
+static void heap_trim(block_t *top)
+{
+    uint32_t start = ((uint32_t)top + sizeof(block_t) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (heap_mapped_top < start + HEAP_TRIM_THRESHOLD)
+        return;
+
+    unmap_range(start, (heap_mapped_top - start) / PAGE_SIZE, true);
+    heap_mapped_top = start;
+}
+
+// marks used block free, merges it with free neighbours and puts it into its bin
+static void block_release(block_t *blk)
+{
+    uint32_t size = block_size(blk);
+
+    block_t *next = block_next(blk);
+    if (!block_used(next))
+    {
+        bin_remove(next);
+        size += block_size(next);
+    }
+
+    uint32_t prev_tag = *(uint32_t *)((uint8_t *)blk - BLOCK_TAG_SIZE);
+    if (!(prev_tag & BLOCK_USED))
+    {
+        block_t *prev = (block_t *)((uint8_t *)blk - (prev_tag & ~7));
+        bin_remove(prev);
+        size += block_size(prev);
+        blk = prev;
+    }
+
+    block_set(blk, size, false);
+    bin_insert(blk);
+
+    if ((uint32_t)block_next(blk) == HEAP_END - BLOCK_TAG_SIZE)
+        heap_trim(blk);
+}
+
+// cuts used block down to need bytes, the rest is released
+static void block_split(block_t *blk, uint32_t need)
+{
+    uint32_t size = block_size(blk);
+    if (size - need < BLOCK_MIN_SIZE)
+        return;
+
+    block_t *rest = (block_t *)((uint8_t *)blk + need);
+    block_set(blk, need, true);
+    block_set(rest, size - need, true);
+    block_release(rest);
+}
+
+// bytes handed out: slab objects plus every used block of the large heap, tags included
+static inline uint32_t heap_bytes_in_use(void)
+{
+    return slab_bytes_in_use + (HEAP_END - SLAB_END - 2 * BLOCK_TAG_SIZE - heap_free_bytes);
+}
+
+static inline void heap_update_peak(void)
+{
+    uint32_t in_use = heap_bytes_in_use();
+    if (in_use > heap_peak_bytes)
+        heap_peak_bytes = in_use;
+}
+
+static void *heap_malloc(uint32_t n)
+{
+    if (n == 0)
+        return NULL;
+
+    if (n <= SLAB_MAX_OBJ_SIZE)
+    {
+        void *obj = slab_alloc(slab_class_of(n));
+        if (obj)
+        {
+            heap_alloc_count++;
+            heap_update_peak();
+            return obj;
+        }
+    }
+
+    if (n > HEAP_END - SLAB_END)
+        return NULL;
+
+    uint32_t need = (n + BLOCK_OVERHEAD + 7) & ~7;
+    if (need < BLOCK_MIN_SIZE)
+        need = BLOCK_MIN_SIZE;
+
+    block_t *blk = bin_find(need);
+    if (!blk)
+        return NULL;
+    bin_remove(blk);
+
+    uint32_t size = block_size(blk);
+    if (size - need >= BLOCK_MIN_SIZE)
+    {
+        block_t *rest = (block_t *)((uint8_t *)blk + need);
+        block_set(rest, size - need, false);
+        bin_insert(rest);
+        size = need;
+    }
+    block_set(blk, size, true);
+
+    heap_alloc_count++;
+    heap_update_peak();
+    return (uint8_t *)blk + BLOCK_TAG_SIZE;
+}
+
+static void heap_free(void *ptr)
 {
     if (!ptr)
         return;
 
-    if ((uint32_t)ptr < HEAP_START || (uint32_t)ptr > HEAP_END)
+    if ((uint32_t)ptr >= SLAB_START && (uint32_t)ptr < SLAB_END)
+    {
+        heap_free_count++;
+        slab_free(ptr);
         return;
+    }
 
-    block_t *blk = (block_t *)((uint8_t *)ptr - sizeof(block_t));
+    if ((uint32_t)ptr < SLAB_END || (uint32_t)ptr >= HEAP_END)
+        return;
 
-    block_t *curr = heap_free_list;
-    block_t *prev = NULL;
+    block_t *blk = (block_t *)((uint8_t *)ptr - BLOCK_TAG_SIZE);
+    if (!block_used(blk))
+        return; // double free
 
-    while (curr && curr < blk)
+    heap_free_count++;
+    block_release(blk);
+}
+
+// grows or shrinks allocation in place when possible, otherwise moves it
+static void *heap_realloc(void *ptr, uint32_t n)
+{
+    if (!ptr)
+        return heap_malloc(n);
+
+    if (n == 0)
     {
-        prev = curr;
-        curr = curr->next;
+        heap_free(ptr);
+        return NULL;
     }
 
-    blk->next = curr;
+    uint32_t old_size;
 
-    if (prev)
-        prev->next = blk;
+    if ((uint32_t)ptr >= SLAB_START && (uint32_t)ptr < SLAB_END)
+    {
+        old_size = ((slab_t *)((uint32_t)ptr & ~(SLAB_SIZE - 1)))->obj_size;
+        if (n <= old_size)
+            return ptr;
+    }
     else
-        heap_free_list = blk;
+    {
+        if (n > HEAP_END - SLAB_END)
+            return NULL;
+
+        block_t *blk = (block_t *)((uint8_t *)ptr - BLOCK_TAG_SIZE);
+        uint32_t size = block_size(blk);
+        uint32_t need = (n + BLOCK_OVERHEAD + 7) & ~7;
+        if (need < BLOCK_MIN_SIZE)
+            need = BLOCK_MIN_SIZE;
+
+        // absorb the following free block when growing
+        block_t *next = block_next(blk);
+        if (need > size && !block_used(next) && size + block_size(next) >= need)
+        {
+            bin_remove(next);
+            size += block_size(next);
+            block_set(blk, size, true);
+        }
+
+        if (need <= size)
+        {
+            block_split(blk, need);
+            heap_update_peak();
+            return ptr;
+        }
+        old_size = size - BLOCK_OVERHEAD;
+    }
+
+    void *new_ptr = heap_malloc(n);
+    if (!new_ptr)
+        return NULL;
+    memcpy(new_ptr, ptr, old_size < n ? old_size : n);
+    heap_free(ptr);
+    return new_ptr;
+}
+
+/* returns block of n bytes whose address is a multiple of align (power of two).
+Padding in front of the block goes back to the heap, so page alignment costs no whole frames */
+static void *heap_malloc_aligned(uint32_t n, uint32_t align)
+{
+    if (n == 0 || (align & (align - 1)))
+        return NULL;
+
+    if (align <= 8)
+        return heap_malloc(n);
+
+    if (n > HEAP_END - SLAB_END || align > HEAP_END - SLAB_END)
+        return NULL;
+
+    uint32_t need = (n + BLOCK_OVERHEAD + 7) & ~7;
+    if (need < BLOCK_MIN_SIZE)
+        need = BLOCK_MIN_SIZE;
 
-    if (blk->next && (uint8_t *)blk + sizeof(block_t) + blk->size == (uint8_t *)blk->next)
+    // worst case padding is align plus a minimal free block in front
+    block_t *blk = bin_find(need + align + BLOCK_MIN_SIZE);
+    if (!blk)
+        return NULL;
+    bin_remove(blk);
+
+    uint32_t payload = (uint32_t)blk + BLOCK_TAG_SIZE;
+    uint32_t aligned = (payload + align - 1) & ~(align - 1);
+    if (aligned != payload && aligned - payload < BLOCK_MIN_SIZE)
+        aligned = (payload + BLOCK_MIN_SIZE + align - 1) & ~(align - 1);
+
+    uint32_t size = block_size(blk);
+    uint32_t lead = aligned - payload;
+    if (lead)
     {
-        blk->size += sizeof(block_t) + blk->next->size;
-        blk->next = blk->next->next;
+        // neighbour in front of a free block is always used, no merge needed
+        block_set(blk, lead, false);
+        bin_insert(blk);
+        blk = (block_t *)(aligned - BLOCK_TAG_SIZE);
+        size -= lead;
     }
 
-    if (prev && (uint8_t *)prev + sizeof(block_t) + prev->size == (uint8_t *)blk)
+    block_set(blk, size, true);
+    block_split(blk, need);
+
+    heap_alloc_count++;
+    heap_update_peak();
+    return (void *)aligned;
+}
+
+// zeroes n bytes at p, skipping heap pages that were not written since being demand-zeroed
+static void heap_zero(uint8_t *p, uint32_t n)
+{
+    uint8_t *end = p + n;
+    while (p < end)
     {
-        prev->size += sizeof(block_t) + blk->size;
-        prev->next = blk->next;
+        uint8_t *page_end = (uint8_t *)(((uint32_t)p & ~(PAGE_SIZE - 1)) + PAGE_SIZE);
+        if (page_end > end)
+            page_end = end;
+        if (get_page_dirty_flag((uint32_t)p))
+            memset(p, 0, page_end - p);
+        p = page_end;
     }
 }
 
+static void *heap_calloc(uint32_t count, uint32_t size)
+{
+    if (size && count > 0xFFFFFFFF / size)
+        return NULL;
+
+    uint32_t n = count * size;
+    uint8_t *ptr = heap_malloc(n);
+    if (!ptr)
+        return NULL;
+
+    if ((uint32_t)ptr < SLAB_END)
+        memset(ptr, 0, n);
+    else
+        heap_zero(ptr, n);
+
+    return ptr;
+}
+
+void *malloc(uint32_t n)
+{
+    void *ptr = heap_malloc(n);
+    HEAP_TRACE_RECORD(HEAP_TRACE_MALLOC, n, ptr);
+    return ptr;
+}
+
+void free(void *ptr)
+{
+    HEAP_TRACE_RECORD(HEAP_TRACE_FREE, 0, ptr);
+    heap_free(ptr);
+}
+
+void *realloc(void *ptr, uint32_t n)
+{
+    void *new_ptr = heap_realloc(ptr, n);
+    if (ptr && (new_ptr || n == 0))
+        HEAP_TRACE_RECORD(HEAP_TRACE_FREE, 0, ptr);
+    if (new_ptr)
+        HEAP_TRACE_RECORD(HEAP_TRACE_REALLOC, n, new_ptr);
+    return new_ptr;
+}
+
+void *calloc(uint32_t count, uint32_t size)
+{
+    void *ptr = heap_calloc(count, size);
+    HEAP_TRACE_RECORD(HEAP_TRACE_CALLOC, count * size, ptr);
+    return ptr;
+}
+
+void *kmalloc_aligned(uint32_t n, uint32_t align)
+{
+    void *ptr = heap_malloc_aligned(n, align);
+    HEAP_TRACE_RECORD(HEAP_TRACE_MALLOC_ALIGNED, n, ptr);
+    return ptr;
+}
+
+void kfree_aligned(void *ptr)
+{
+    HEAP_TRACE_RECORD(HEAP_TRACE_FREE, 0, ptr);
+    heap_free(ptr);
+}
+
 void dump_heap(void)
 {
     serial_write_char('\n');
 
-    for (block_t *curr = heap_free_list, *prev = NULL; curr != NULL; prev = curr, curr = curr->next)
+    for (uint32_t i = 0; i < SLAB_CLASS_COUNT; i++)
     {
-        serial_write_hex_uint32(curr);
-        serial_write_str(" -> SIZE: ");
-        serial_write_hex_uint32(curr->size);
+        slab_class_t *cls = &slab_classes[i];
+        uint32_t obj_size = SLAB_MIN_OBJ_SIZE << i;
+
+        serial_write_str("SLAB ");
+        serial_write_uint32(obj_size);
+        serial_write_str(" -> SLABS: ");
+        serial_write_uint32(cls->slabs);
+        serial_write_str(" USED: ");
+        serial_write_uint32(cls->objects_in_use);
+        serial_write_char('/');
+        serial_write_uint32(cls->slabs * ((SLAB_SIZE - SLAB_OBJS_OFFSET) / obj_size));
         serial_write_char('\n');
     }
+
+    for (uint32_t fl = 0; fl < BIN_FL_COUNT; fl++)
+        for (uint32_t sl = 0; sl < BIN_SL_COUNT; sl++)
+            for (block_t *curr = heap_bins[fl][sl]; curr != NULL; curr = curr->next)
+            {
+                serial_write_hex_uint32((uint32_t)curr);
+                serial_write_str(" -> SIZE: ");
+                serial_write_hex_uint32(block_size(curr));
+                serial_write_char('\n');
+            }
+}
+
+// size of the largest free block. Only the highest non-empty bin is walked
+static uint32_t heap_largest_free_block(void)
+{
+    if (!heap_fl_bitmap)
+        return 0;
+
+    uint32_t fl = 31 - __builtin_clz(heap_fl_bitmap);
+    uint32_t sl = 31 - __builtin_clz(heap_sl_bitmap[fl]);
+
+    uint32_t largest = 0;
+    for (block_t *curr = heap_bins[fl][sl]; curr != NULL; curr = curr->next)
+        if (block_size(curr) > largest)
+            largest = block_size(curr);
+    return largest;
+}
+
+void heap_get_stats(heap_stats_t *stats)
+{
+    stats->bytes_in_use = heap_bytes_in_use();
+    stats->peak_bytes_in_use = heap_peak_bytes;
+    stats->alloc_count = heap_alloc_count;
+    stats->free_count = heap_free_count;
+    stats->free_bytes = heap_free_bytes;
+    stats->free_blocks = heap_free_blocks;
+    stats->largest_free_block = heap_largest_free_block();
+
+    // scaled down so `largest * 100` fits 32 bits, there is no libgcc for 64-bit division
+    uint32_t free_bytes = heap_free_bytes;
+    uint32_t largest = stats->largest_free_block;
+    while (free_bytes > 0x1000000)
+    {
+        free_bytes >>= 1;
+        largest >>= 1;
+    }
+    stats->fragmentation = free_bytes ? 100 - largest * 100 / free_bytes : 0;
+}
+
+void heap_print_stats(void)
+{
+    heap_stats_t stats;
+    heap_get_stats(&stats);
+
+    serial_write_str("\nHEAP IN USE: ");
+    serial_write_uint32(stats.bytes_in_use);
+    serial_write_str(" PEAK: ");
+    serial_write_uint32(stats.peak_bytes_in_use);
+    serial_write_str("\nALLOCS: ");
+    serial_write_uint32(stats.alloc_count);
+    serial_write_str(" FREES: ");
+    serial_write_uint32(stats.free_count);
+    serial_write_str("\nFREE: ");
+    serial_write_uint32(stats.free_bytes);
+    serial_write_str(" IN ");
+    serial_write_uint32(stats.free_blocks);
+    serial_write_str(" BLOCKS, LARGEST: ");
+    serial_write_uint32(stats.largest_free_block);
+    serial_write_str("\nFRAGMENTATION: ");
+    serial_write_uint32(stats.fragmentation);
+    serial_write_str("%\n");
 }
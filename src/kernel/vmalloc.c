@@ -0,0 +1,180 @@
+#include <kernel/vmalloc.h>
+#include <paging/paging.h>
+#include <paging/vm_region.h>
+#include <lib/mem.h>
+
+#include <drivers/qemu_serial.h>
+
+typedef struct
+{
+    uint32_t start;
+    uint32_t pages;
+} vm_range_t;
+
+// free virtual ranges sorted by start, neighbours are always merged
+static vm_range_t free_ranges[VMALLOC_MAX_RANGES];
+static uint32_t free_range_count = 0;
+
+// live areas, pages include the guard page
+static vm_range_t areas[VMALLOC_MAX_AREAS];
+static uint32_t area_count = 0;
+
+static uint32_t vmalloc_pages_in_use = 0;
+
+void vmalloc_init(void)
+{
+    free_ranges[0].start = VMALLOC_START;
+    free_ranges[0].pages = (VMALLOC_END - VMALLOC_START) / PAGE_SIZE;
+    free_range_count = 1;
+    area_count = 0;
+    vmalloc_pages_in_use = 0;
+
+    // areas are mapped up front, faults in the window only break copy-on-write or hit a guard page
+    vm_region_register("vmalloc", VMALLOC_START, VMALLOC_END, VM_REGION_WRITABLE, NULL);
+}
+
+// first fit, returns 0 if no free range is big enough
+static uint32_t take_range(uint32_t pages)
+{
+    for (uint32_t i = 0; i < free_range_count; i++)
+    {
+        if (free_ranges[i].pages < pages)
+            continue;
+
+        uint32_t start = free_ranges[i].start;
+        free_ranges[i].start += pages * PAGE_SIZE;
+        free_ranges[i].pages -= pages;
+        if (!free_ranges[i].pages)
+        {
+            free_range_count--;
+            memmove(&free_ranges[i], &free_ranges[i + 1], (free_range_count - i) * sizeof(vm_range_t));
+        }
+        return start;
+    }
+    return 0;
+}
+
+static void give_range(uint32_t start, uint32_t pages)
+{
+    uint32_t pos = 0;
+    while (pos < free_range_count && free_ranges[pos].start < start)
+        pos++;
+
+    bool_t merge_prev = pos > 0 && free_ranges[pos - 1].start + free_ranges[pos - 1].pages * PAGE_SIZE == start;
+    bool_t merge_next = pos < free_range_count && start + pages * PAGE_SIZE == free_ranges[pos].start;
+
+    if (merge_prev && merge_next)
+    {
+        free_ranges[pos - 1].pages += pages + free_ranges[pos].pages;
+        free_range_count--;
+        memmove(&free_ranges[pos], &free_ranges[pos + 1], (free_range_count - pos) * sizeof(vm_range_t));
+    }
+    else if (merge_prev)
+        free_ranges[pos - 1].pages += pages;
+    else if (merge_next)
+    {
+        free_ranges[pos].start = start;
+        free_ranges[pos].pages += pages;
+    }
+    else if (free_range_count < VMALLOC_MAX_RANGES)
+    {
+        memmove(&free_ranges[pos + 1], &free_ranges[pos], (free_range_count - pos) * sizeof(vm_range_t));
+        free_ranges[pos].start = start;
+        free_ranges[pos].pages = pages;
+        free_range_count++;
+    }
+    else
+        serial_write_str("vmalloc: free range table is full, virtual range leaked\n");
+}
+
+// reserves virtual range for `size` bytes plus guard page and records the area
+static uint32_t vmalloc_reserve(uint32_t size, uint32_t *pages)
+{
+    // bigger sizes would also wrap when rounded up to pages
+    if (!size || size > VMALLOC_END - VMALLOC_START || area_count == VMALLOC_MAX_AREAS)
+        return 0;
+
+    *pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t start = take_range(*pages + 1);
+    if (!start)
+        return 0;
+
+    areas[area_count].start = start;
+    areas[area_count].pages = *pages + 1;
+    area_count++;
+    return start;
+}
+
+static void vmalloc_release(uint32_t index)
+{
+    give_range(areas[index].start, areas[index].pages);
+    areas[index] = areas[--area_count];
+}
+
+void *vmalloc(uint32_t size)
+{
+    uint32_t pages;
+    uint32_t start = vmalloc_reserve(size, &pages);
+    if (!start)
+        return NULL;
+
+    if (!map_alloc_range(start, pages, PAGE_PRESENT | PAGE_RW))
+    {
+        vmalloc_release(area_count - 1);
+        return NULL;
+    }
+
+    vmalloc_pages_in_use += pages;
+    return (void *)start;
+}
+
+void *vzalloc(uint32_t size)
+{
+    uint32_t pages;
+    uint32_t start = vmalloc_reserve(size, &pages);
+    if (!start)
+        return NULL;
+
+    if (!map_zero_range(start, pages))
+    {
+        unmap_range(start, pages, true);
+        vmalloc_release(area_count - 1);
+        return NULL;
+    }
+
+    vmalloc_pages_in_use += pages;
+    return (void *)start;
+}
+
+void vfree(void *addr)
+{
+    for (uint32_t i = 0; i < area_count; i++)
+    {
+        if (areas[i].start != (uint32_t)addr)
+            continue;
+
+        uint32_t pages = areas[i].pages - 1;
+        unmap_range(areas[i].start, pages, true);
+        vmalloc_pages_in_use -= pages;
+        vmalloc_release(i);
+        return;
+    }
+}
+
+void vmalloc_print_stats(void)
+{
+    uint32_t largest = 0;
+    for (uint32_t i = 0; i < free_range_count; i++)
+        if (free_ranges[i].pages > largest)
+            largest = free_ranges[i].pages;
+
+    serial_write_str("\nVMALLOC AREAS: ");
+    serial_write_uint32(area_count);
+    serial_write_str(" PAGES: ");
+    serial_write_uint32(vmalloc_pages_in_use);
+    serial_write_str("\nFREE RANGES: ");
+    serial_write_uint32(free_range_count);
+    serial_write_str(" LARGEST: ");
+    serial_write_uint32(largest);
+    serial_write_str(" PAGES\n");
+}
@@ -0,0 +1,221 @@
+#include <kernel/working_set.h>
+#include <kernel/vmalloc.h>
+#include <paging/paging.h>
+#include <paging/vm_region.h>
+#include <timer/pit.h>
+#include <cpu.h>
+#include <lib/mem.h>
+
+#include <drivers/qemu_serial.h>
+
+typedef struct
+{
+    working_set_stats_t stats;     // last completed pass
+    working_set_stats_t pass;      // pass in progress
+    uint8_t cold_age[WS_LIST_MAX]; // ages of pass.cold entries
+    uint8_t *age;                  // per page passes since last access, saturates at 255
+    uint32_t pages;
+    uint32_t cursor; // next page of the pass
+    uint64_t pass_start;
+} ws_region_t;
+
+static ws_region_t tracked[VM_REGION_MAX];
+static uint32_t tracked_count = 0;
+static uint32_t scan_index = 0; // region the cursor is in
+static uint32_t step_ticks = 0;
+
+// keeps pass.cold sorted by age, the oldest WS_LIST_MAX pages stay
+static void add_cold_page(ws_region_t *r, uint32_t virt, uint8_t age)
+{
+    working_set_stats_t *p = &r->pass;
+    uint32_t pos = p->cold_count;
+    if (pos == WS_LIST_MAX)
+    {
+        if (age <= r->cold_age[pos - 1])
+            return;
+        pos--;
+    }
+    else
+        p->cold_count++;
+
+    for (; pos > 0 && r->cold_age[pos - 1] < age; pos--)
+    {
+        r->cold_age[pos] = r->cold_age[pos - 1];
+        p->cold[pos] = p->cold[pos - 1];
+    }
+    r->cold_age[pos] = age;
+    p->cold[pos] = virt;
+}
+
+static void account_page(ws_region_t *r, uint32_t virt, uint32_t bits)
+{
+    uint8_t *age = &r->age[r->cursor++];
+    if (!(bits & PAGE_SCAN_PRESENT))
+    {
+        *age = 0;
+        return;
+    }
+
+    if (bits & PAGE_SCAN_ACCESSED)
+        *age = 0;
+    else if (*age < 0xFF)
+        (*age)++;
+
+    working_set_stats_t *p = &r->pass;
+    p->resident_pages++;
+    if (bits & PAGE_SCAN_DIRTY)
+        p->dirty_pages++;
+    if (*age < WS_WINDOW_PASSES)
+        p->working_set_pages++;
+
+    if (*age == 0)
+    {
+        p->hot_pages++;
+        if (p->hot_count < WS_LIST_MAX)
+            p->hot[p->hot_count++] = virt;
+    }
+    else if (*age >= WS_COLD_PASSES)
+    {
+        p->cold_pages++;
+        add_cold_page(r, virt, *age);
+    }
+}
+
+static void finish_pass(ws_region_t *r)
+{
+    uint64_t now = get_timer_ticks();
+    working_set_stats_t *p = &r->pass;
+
+    p->passes = r->stats.passes + 1;
+    p->pass_ticks = (uint32_t)(now - r->pass_start);
+    r->stats = *p;
+
+    p->resident_pages = 0;
+    p->working_set_pages = 0;
+    p->hot_pages = 0;
+    p->cold_pages = 0;
+    p->dirty_pages = 0;
+    p->hot_count = 0;
+    p->cold_count = 0;
+
+    r->cursor = 0;
+    r->pass_start = now;
+}
+
+// PIT task, samples up to WS_SCAN_BUDGET entries every WS_TICKS_PER_STEP ticks
+static void working_set_step(void)
+{
+    if (++step_ticks < WS_TICKS_PER_STEP || !tracked_count)
+        return;
+    step_ticks = 0;
+
+    for (uint32_t budget = WS_SCAN_BUDGET; budget > 0; budget--)
+    {
+        ws_region_t *r = &tracked[scan_index];
+        uint32_t virt = r->pass.start + r->cursor * PAGE_SIZE;
+        uint32_t bits = scan_page_access(virt);
+
+        if (bits & PAGE_SCAN_NO_TABLE)
+        {
+            // nothing mapped up to the end of this PD entry
+            uint32_t skip = PAGES_PER_TABLE - ((virt >> 12) & (PAGES_PER_TABLE - 1));
+            if (skip > r->pages - r->cursor)
+                skip = r->pages - r->cursor;
+            memset(r->age + r->cursor, 0, skip);
+            r->cursor += skip;
+        }
+        else
+            account_page(r, virt, bits);
+
+        if (r->cursor == r->pages)
+        {
+            finish_pass(r);
+            scan_index = (scan_index + 1) % tracked_count;
+        }
+    }
+}
+
+void working_set_init(void)
+{
+    for (uint32_t i = 0; i < vm_region_count(); i++)
+    {
+        vm_region_t *region = vm_region_get(i);
+        uint32_t pages = (region->end - region->start) / PAGE_SIZE;
+
+        // mapped up front, the PIT task must not fault on it
+        uint8_t *age = vmalloc(pages);
+        if (!age)
+            continue;
+        memset(age, 0, pages);
+
+        ws_region_t *r = &tracked[tracked_count++];
+        memset(r, 0, sizeof(ws_region_t));
+        r->pass.name = region->name;
+        r->pass.start = region->start;
+        r->pass.end = region->end;
+        r->stats = r->pass;
+        r->age = age;
+        r->pages = pages;
+        r->pass_start = get_timer_ticks();
+    }
+
+    if (tracked_count)
+        register_pit_task(working_set_step);
+}
+
+uint32_t working_set_region_count(void)
+{
+    return tracked_count;
+}
+
+bool_t working_set_get_stats(uint32_t index, working_set_stats_t *out)
+{
+    if (index >= tracked_count)
+        return false;
+
+    uint32_t eflags = irq_save();
+    *out = tracked[index].stats;
+    irq_restore(eflags);
+    return true;
+}
+
+static void print_page_list(const char *label, const uint32_t *pages, uint32_t count)
+{
+    serial_write_str(label);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        serial_write_str(" ");
+        serial_write_hex_uint32(pages[i]);
+    }
+}
+
+void working_set_print_stats(void)
+{
+    working_set_stats_t stats;
+    for (uint32_t i = 0; working_set_get_stats(i, &stats); i++)
+    {
+        serial_write_str("\nWORKING SET ");
+        serial_write_str(stats.name);
+        serial_write_str(" ");
+        serial_write_hex_uint32(stats.start);
+        serial_write_str("-");
+        serial_write_hex_uint32(stats.end);
+        serial_write_str(" PASSES: ");
+        serial_write_uint32(stats.passes);
+        serial_write_str(" TICKS: ");
+        serial_write_uint32(stats.pass_ticks);
+        serial_write_str("\nRESIDENT: ");
+        serial_write_uint32(stats.resident_pages);
+        serial_write_str(" WS: ");
+        serial_write_uint32(stats.working_set_pages);
+        serial_write_str(" HOT: ");
+        serial_write_uint32(stats.hot_pages);
+        serial_write_str(" COLD: ");
+        serial_write_uint32(stats.cold_pages);
+        serial_write_str(" DIRTY: ");
+        serial_write_uint32(stats.dirty_pages);
+        print_page_list("\nHOT PAGES:", stats.hot, stats.hot_count);
+        print_page_list("\nCOLD PAGES:", stats.cold, stats.cold_count);
+    }
+    serial_write_str("\n");
+}
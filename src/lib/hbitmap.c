@@ -0,0 +1,79 @@
+#include <lib/hbitmap.h>
+
+// storage must hold HBITMAP_WORDS(bits) words. All bits start clear
+void hbitmap_init(hbitmap_t *bm, uint32_t *storage, uint32_t bits)
+{
+    bm->bits = bits;
+    bm->level_count = 0;
+
+    uint32_t words = (bits + 31) / 32;
+    while (true)
+    {
+        bm->levels[bm->level_count++] = storage;
+        for (uint32_t i = 0; i < words; i++)
+            storage[i] = 0;
+        storage += words;
+
+        if (words <= 1 || bm->level_count == HBITMAP_MAX_LEVELS)
+            break;
+        words = (words + 31) / 32;
+    }
+}
+
+// sets bit at given level and propagates to summaries above it
+static void hbitmap_set_from(hbitmap_t *bm, uint32_t level, uint32_t index)
+{
+    for (; level < bm->level_count; level++)
+    {
+        uint32_t *word = &bm->levels[level][index / 32];
+        bool_t was_zero = *word == 0;
+        *word |= 1u << (index % 32);
+        if (!was_zero)
+            return;
+        index /= 32;
+    }
+}
+
+static void hbitmap_clear_from(hbitmap_t *bm, uint32_t level, uint32_t index)
+{
+    for (; level < bm->level_count; level++)
+    {
+        uint32_t *word = &bm->levels[level][index / 32];
+        *word &= ~(1u << (index % 32));
+        if (*word)
+            return;
+        index /= 32;
+    }
+}
+
+void hbitmap_set(hbitmap_t *bm, uint32_t index)
+{
+    hbitmap_set_from(bm, 0, index);
+}
+
+void hbitmap_clear(hbitmap_t *bm, uint32_t index)
+{
+    hbitmap_clear_from(bm, 0, index);
+}
+
+bool_t hbitmap_get(const hbitmap_t *bm, uint32_t index)
+{
+    return (bm->levels[0][index / 32] >> (index % 32)) & 1;
+}
+
+// returns index of the lowest set bit or -1 if there is none
+int32_t hbitmap_find_first(const hbitmap_t *bm)
+{
+    if (!bm->bits)
+        return -1;
+
+    uint32_t index = 0;
+    for (int32_t level = bm->level_count - 1; level >= 0; level--)
+    {
+        uint32_t word = bm->levels[level][index];
+        if (!word)
+            return -1;
+        index = index * 32 + __builtin_ctz(word);
+    }
+    return index < bm->bits ? (int32_t)index : -1;
+}
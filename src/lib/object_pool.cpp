@@ -0,0 +1,16 @@
+#include <lib/object_pool.hpp>
+
+// pools are header only, they are instantiated here so the kernel build compiles them
+
+template class ObjectPool<uint32_t, 4>;
+template uint32_t *ObjectPool<uint32_t, 4>::acquire<uint32_t>(uint32_t &&);
+
+template class DynamicPool<uint32_t>;
+template uint32_t *DynamicPool<uint32_t>::acquire<uint32_t>(uint32_t &&);
+
+// kernel has neither global constructors nor __cxa_atexit, pools must be constant initialized
+// and must not need a destructor call
+static_assert((ObjectPool<uint32_t, 4>(), true), "ObjectPool is not constant initialized");
+static_assert((DynamicPool<uint32_t>(), true), "DynamicPool is not constant initialized");
+static_assert(__has_trivial_destructor(ObjectPool<uint32_t, 4>), "ObjectPool needs a destructor call");
+static_assert(__has_trivial_destructor(DynamicPool<uint32_t>), "DynamicPool needs a destructor call");
@@ -0,0 +1,187 @@
+/* Host benchmark for the kernel heap (src/kernel/memory.c).
+Replays synthetic workloads and reports throughput and fragmentation.
+Build and run with `make heap_bench` */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+// kernel heap API, renamed like in the Makefile to stay clear of libc
+#define malloc kheap_malloc
+#define free kheap_free
+#define realloc kheap_realloc
+#define calloc kheap_calloc
+#include <kernel/memory.h>
+#undef malloc
+#undef free
+#undef realloc
+#undef calloc
+
+#define LIVE_SLOTS 4096
+#define OPS 2000000
+
+typedef struct
+{
+    const char *name;
+    void (*run)(void);
+} workload_t;
+
+static void *live[LIVE_SLOTS];
+static uint32_t rng_state = 0x12345678;
+static uint32_t fragmentation_sample;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static uint32_t rng_range(uint32_t min, uint32_t max)
+{
+    return min + rng() % (max - min + 1);
+}
+
+static void touch(void *ptr)
+{
+    if (ptr)
+        *(volatile uint8_t *)ptr = 1;
+}
+
+static void release_all(void)
+{
+    for (uint32_t i = 0; i < LIVE_SLOTS; i++)
+    {
+        kheap_free(live[i]);
+        live[i] = NULL;
+    }
+}
+
+static void sample_fragmentation(void)
+{
+    heap_stats_t stats;
+    heap_get_stats(&stats);
+    fragmentation_sample = stats.fragmentation;
+}
+
+// random alloc/free of 8..256 bytes
+static void uniform_small(void)
+{
+    for (uint32_t op = 0; op < OPS; op++)
+    {
+        uint32_t slot = rng() % LIVE_SLOTS;
+        if (live[slot])
+        {
+            kheap_free(live[slot]);
+            live[slot] = NULL;
+        }
+        else
+            touch(live[slot] = kheap_malloc(rng_range(8, 256)));
+    }
+    sample_fragmentation();
+}
+
+// 90% 16..64 bytes, 10% 4..64 KiB
+static void bimodal(void)
+{
+    for (uint32_t op = 0; op < OPS; op++)
+    {
+        uint32_t slot = rng() % LIVE_SLOTS;
+        if (live[slot])
+        {
+            kheap_free(live[slot]);
+            live[slot] = NULL;
+        }
+        else
+            touch(live[slot] = kheap_malloc(rng() % 10 ? rng_range(16, 64) : rng_range(4096, 65536)));
+    }
+    sample_fragmentation();
+}
+
+// FIFO queue: buffers are freed in allocation order, like events passed between subsystems
+static void producer_consumer(void)
+{
+    uint32_t head = 0, tail = 0;
+    for (uint32_t op = 0; op < OPS / 2; op++)
+    {
+        touch(live[head++ % LIVE_SLOTS] = kheap_malloc(rng_range(32, 4096)));
+        if (head - tail > LIVE_SLOTS / 2)
+        {
+            kheap_free(live[tail % LIVE_SLOTS]);
+            live[tail++ % LIVE_SLOTS] = NULL;
+        }
+    }
+    sample_fragmentation();
+}
+
+// fill with mixed sizes, free every other block, then ask for blocks that do not fit the holes
+static void fragmenting(void)
+{
+    for (uint32_t round = 0; round < OPS / (2 * LIVE_SLOTS); round++)
+    {
+        for (uint32_t i = 0; i < LIVE_SLOTS; i++)
+            touch(live[i] = kheap_malloc(rng_range(2100, 12000)));
+        for (uint32_t i = 0; i < LIVE_SLOTS; i += 2)
+        {
+            kheap_free(live[i]);
+            live[i] = NULL;
+        }
+        for (uint32_t i = 0; i < LIVE_SLOTS; i += 2)
+            touch(live[i] = kheap_realloc(NULL, rng_range(12000, 24000)));
+        if (round == 0)
+            sample_fragmentation();
+        release_all();
+    }
+}
+
+static const workload_t workloads[] = {
+    {"uniform_small", uniform_small},
+    {"bimodal", bimodal},
+    {"producer_consumer", producer_consumer},
+    {"fragmenting", fragmenting},
+};
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    void *window = mmap((void *)HEAP_START, HEAP_END - HEAP_START, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_NORESERVE, -1, 0);
+    if (window != (void *)HEAP_START)
+    {
+        perror("mmap heap window");
+        return 1;
+    }
+
+    printf("%-18s %12s %12s %12s %8s\n", "workload", "ops", "Mops/s", "peak KiB", "frag %");
+
+    for (uint32_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+    {
+        heap_init();
+        memset(live, 0, sizeof(live));
+        rng_state = 0x12345678;
+
+        double start = now_seconds();
+        workloads[i].run();
+        release_all();
+        double elapsed = now_seconds() - start;
+
+        heap_stats_t stats;
+        heap_get_stats(&stats);
+        uint32_t ops = stats.alloc_count + stats.free_count;
+
+        printf("%-18s %12u %12.2f %12u %8u\n", workloads[i].name, ops, ops / elapsed / 1e6,
+               stats.peak_bytes_in_use / 1024, fragmentation_sample);
+    }
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+/* host stand-in for include/lib/types.h, so kernel headers used by the benchmark
+take integer types from libc instead of clashing with them */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint8_t bool_t;
+#define true 1
+#define false 0
+
+typedef void (*func_t)();
@@ -0,0 +1,55 @@
+/* Host stand-ins for everything src/kernel/memory.c needs from paging and serial.
+The heap window itself is a lazily backed mmap at HEAP_START, see heap_bench.c */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+
+#define PAGE_SIZE 0x1000
+
+void unmap_range(uint32_t virt_start, uint32_t pages, uint8_t free_frames)
+{
+    (void)free_frames;
+    madvise((void *)(uintptr_t)virt_start, pages * PAGE_SIZE, MADV_DONTNEED);
+}
+
+void *vm_region_register(const char *name, uint32_t start, uint32_t end, uint32_t flags, void *on_fault)
+{
+    (void)name;
+    (void)start;
+    (void)end;
+    (void)flags;
+    (void)on_fault;
+    return NULL; // host mmap backs the window, no fault handling needed
+}
+
+uint8_t get_page_dirty_flag(uint32_t virt)
+{
+    (void)virt;
+    return 1; // no dirty tracking on host, calloc always zeroes
+}
+
+void serial_write_char(char c)
+{
+    putchar(c);
+}
+
+void serial_write_str(const char *s)
+{
+    fputs(s, stdout);
+}
+
+void serial_write_bytes(const void *data, uint32_t length)
+{
+    fwrite(data, 1, length, stdout);
+}
+
+void serial_write_uint32(uint32_t value)
+{
+    printf("%u", value);
+}
+
+void serial_write_hex_uint32(uint32_t value)
+{
+    printf("%08X", value);
+}
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+Aggregates heap trace frames drained by heap_trace_drain() by call site.
+
+Build with `make clean && make HEAP_TRACE=1`, capture serial output to a file, e.g.
+    qemu-system-i386 -serial file:heap_trace.bin -drive file=build/metabar.img,format=raw
+then run
+    tools/heap_trace.py heap_trace.bin [build/kernel.elf]
+"""
+
+import shutil
+import struct
+import subprocess
+import sys
+from collections import defaultdict
+
+FRAME_MAGIC = b"HTRC"
+FRAME_HEADER = struct.Struct("<II")   # count, dropped
+RECORD = struct.Struct("<IIIIB")      # timestamp, caller, size, ptr, op
+
+OP_NAMES = {1: "malloc", 2: "free", 3: "realloc", 4: "calloc", 5: "kmalloc_aligned"}
+OP_FREE = 2
+
+
+def read_records(data):
+    """Yields records of every frame found in the capture, skipping text output between frames."""
+    dropped = 0
+    pos = data.find(FRAME_MAGIC)
+    while pos != -1:
+        pos += len(FRAME_MAGIC)
+        if pos + FRAME_HEADER.size > len(data):
+            break
+        count, frame_dropped = FRAME_HEADER.unpack_from(data, pos)
+        pos += FRAME_HEADER.size
+        end = pos + count * RECORD.size
+        if end > len(data):
+            break
+        dropped += frame_dropped
+        for i in range(count):
+            yield RECORD.unpack_from(data, pos + i * RECORD.size)
+        pos = data.find(FRAME_MAGIC, end)
+    if dropped:
+        print(f"warning: {dropped} records were overwritten before drain", file=sys.stderr)
+
+
+def symbolize(addresses, elf):
+    """Maps return addresses to 'function file:line' with addr2line."""
+    tool = shutil.which("i386-elf-addr2line") or shutil.which("addr2line")
+    if not tool or not addresses:
+        return {addr: f"0x{addr:08X}" for addr in addresses}
+
+    addresses = sorted(addresses)
+    # return address points after the call, step back into the call instruction
+    out = subprocess.run([tool, "-f", "-C", "-s", "-e", elf] + [f"0x{a - 1:X}" for a in addresses],
+                         capture_output=True, text=True, check=False).stdout.splitlines()
+
+    names = {}
+    for i, addr in enumerate(addresses):
+        func = out[2 * i] if 2 * i < len(out) else "??"
+        line = out[2 * i + 1] if 2 * i + 1 < len(out) else "??"
+        names[addr] = f"0x{addr:08X} {func} {line}"
+    return names
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__.strip())
+        return 1
+
+    elf = sys.argv[2] if len(sys.argv) > 2 else "build/kernel.elf"
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+
+    sites = defaultdict(lambda: {"allocs": 0, "frees": 0, "bytes": 0, "live": 0})
+    live = {}  # ptr -> (caller, size)
+
+    for _, caller, size, ptr, op in read_records(data):
+        site = sites[caller]
+        if op == OP_FREE:
+            site["frees"] += 1
+            if ptr in live:
+                owner, owner_size = live.pop(ptr)
+                sites[owner]["live"] -= owner_size
+        elif op in OP_NAMES and ptr:
+            site["allocs"] += 1
+            site["bytes"] += size
+            site["live"] += size
+            live[ptr] = (caller, size)
+
+    names = symbolize(list(sites), elf)
+
+    print(f"{'allocs':>8} {'frees':>8} {'bytes':>12} {'live':>10}  call site")
+    for caller, site in sorted(sites.items(), key=lambda kv: kv[1]["allocs"] + kv[1]["frees"], reverse=True):
+        print(f"{site['allocs']:>8} {site['frees']:>8} {site['bytes']:>12} {site['live']:>10}  {names[caller]}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())